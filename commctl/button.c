@@ -13,16 +13,16 @@ extern window_t *get_root_window(window_t *window);
 result_t win_button(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   switch (msg) {
     case kWindowMessageCreate:
-      win->frame.w = MAX(win->frame.w, strwidth(win->title)+6);
+      win->frame.w = MAX(win->frame.w, strwidth(win->cold->title)+6);
       win->frame.h = MAX(win->frame.h, BUTTON_HEIGHT);
       return true;
     case kWindowMessagePaint:
       fill_rect(_focused == win?COLOR_FOCUSED:COLOR_PANEL_BG, win->frame.x-2, win->frame.y-2, win->frame.w+4, win->frame.h+4);
       draw_button(&win->frame, 1, 1, win->pressed);
       if (!win->pressed) {
-        draw_text_small(win->title, win->frame.x+4, win->frame.y+4, COLOR_DARK_EDGE);
+        draw_text_small(win->cold->title, win->frame.x+4, win->frame.y+4, COLOR_DARK_EDGE);
       }
-      draw_text_small(win->title, win->frame.x+((win->pressed)?4:3), win->frame.y+((win->pressed)?4:3), COLOR_TEXT_NORMAL);
+      draw_text_small(win->cold->title, win->frame.x+((win->pressed)?4:3), win->frame.y+((win->pressed)?4:3), COLOR_TEXT_NORMAL);
       return true;
     case kWindowMessageLeftButtonDown:
       win->pressed = true;
@@ -14,14 +14,14 @@ extern window_t *_focused;
 result_t win_checkbox(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   switch (msg) {
     case kWindowMessageCreate:
-      win->frame.w = MAX(win->frame.w, strwidth(win->title)+16);
+      win->frame.w = MAX(win->frame.w, strwidth(win->cold->title)+16);
       win->frame.h = MAX(win->frame.h, BUTTON_HEIGHT);
       return true;
     case kWindowMessagePaint:
       fill_rect(_focused == win?COLOR_FOCUSED:COLOR_PANEL_BG, win->frame.x-2, win->frame.y-2, 14, 14);
       draw_button(MAKERECT(win->frame.x, win->frame.y, 10, 10), 1, 1, win->pressed);
-      draw_text_small(win->title, win->frame.x + 17, win->frame.y + 3, COLOR_DARK_EDGE);
-      draw_text_small(win->title, win->frame.x + 16, win->frame.y + 2, COLOR_TEXT_NORMAL);
+      draw_text_small(win->cold->title, win->frame.x + 17, win->frame.y + 3, COLOR_DARK_EDGE);
+      draw_text_small(win->cold->title, win->frame.x + 16, win->frame.y + 2, COLOR_TEXT_NORMAL);
       if (win->value) {
         draw_icon8(icon8_checkbox, win->frame.x+1, win->frame.y+1, COLOR_TEXT_NORMAL);
       }
@@ -38,6 +38,7 @@ result_t win_checkbox(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
       return true;
     case kButtonMessageSetCheck:
       win->value = (wparam != kButtonStateUnchecked);
+      invalidate_window(win);
       return true;
     case kButtonMessageGetCheck:
       return win->value ? kButtonStateChecked : kButtonStateUnchecked;
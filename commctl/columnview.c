@@ -38,13 +38,13 @@ static inline int get_column_count(int window_width, int column_width) {
 
 // ColumnView control window procedure
 result_t win_columnview(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
-  columnview_data_t *data = (columnview_data_t *)win->userdata2;
+  columnview_data_t *data = (columnview_data_t *)win->cold->userdata2;
   
   switch (msg) {
     case kWindowMessageCreate: {
-      data = malloc(sizeof(columnview_data_t));
+      data = alloc_window_memory(win, sizeof(columnview_data_t));
       if (!data) return false;
-      win->userdata2 = data;
+      win->cold->userdata2 = data;
       win->flags |= WINDOW_VSCROLL;
       data->count = 0;
       data->selected = -1;
@@ -216,9 +216,7 @@ result_t win_columnview(window_t *win, uint32_t msg, uint32_t wparam, void *lpar
     }
     
     case kWindowMessageDestroy:
-      if (data) {
-        free(data);
-      }
+      free_window_memory(data);
       return true;
     
     default:
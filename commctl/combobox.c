@@ -23,11 +23,11 @@ result_t win_combobox(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
   switch (msg) {
     case kWindowMessageCreate:
       win_button(win, msg, wparam, lparam);
-      win->frame.w = MAX(win->frame.w, strwidth(win->title)+16);
-      win->userdata = malloc(sizeof(combobox_string_t) * MAX_COMBOBOX_STRINGS);
+      win->frame.w = MAX(win->frame.w, strwidth(win->cold->title)+16);
+      win->userdata = alloc_window_memory(win, sizeof(combobox_string_t) * MAX_COMBOBOX_STRINGS);
       return true;
     case kWindowMessageDestroy:
-      free(win->userdata);
+      free_window_memory(win->userdata);
       return true;
     case kWindowMessagePaint:
       win_button(win, msg, wparam, lparam);
@@ -41,36 +41,36 @@ result_t win_combobox(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
         win->frame.w,
         100,
       };
-      window_t *list = create_window("", WINDOW_NOTITLE|WINDOW_NORESIZE|WINDOW_VSCROLL, &rect, NULL, win_list, win);
+      window_t *list = create_window("", WINDOW_NOTITLE|WINDOW_NORESIZE|WINDOW_VSCROLL|WINDOW_POPUP, &rect, NULL, win_list, win);
       send_message(list, 0x5001 /*LIST_SELITEM*/, 2, NULL);
       set_capture(list);
       return true;
     }
     case kComboBoxMessageAddString:
-      if (win->cursor_pos < MAX_COMBOBOX_STRINGS) {
-        strncpy(texts[win->cursor_pos++], lparam, sizeof(combobox_string_t));
-        strncpy(win->title, lparam, sizeof(win->title));
+      if (win->cold->cursor_pos < MAX_COMBOBOX_STRINGS) {
+        strncpy(texts[win->cold->cursor_pos++], lparam, sizeof(combobox_string_t));
+        strncpy(win->cold->title, lparam, sizeof(win->cold->title));
         return true;
       } else {
         return false;
       }
     case kComboBoxMessageGetListBoxText:
-      if (wparam < win->cursor_pos) {
+      if (wparam < win->cold->cursor_pos) {
         strcpy(lparam, texts[wparam]);
         return true;
       } else {
         return false;
       }
     case kComboBoxMessageSetCurrentSelection:
-      if (wparam < win->cursor_pos) {
-        strncpy(win->title, texts[wparam], sizeof(win->title));
+      if (wparam < win->cold->cursor_pos) {
+        strncpy(win->cold->title, texts[wparam], sizeof(win->cold->title));
         return true;
       } else {
         return false;
       }
     case kComboBoxMessageGetCurrentSelection:
-      for (uint32_t i = 0; i < win->cursor_pos; i++) {
-        if (!strncmp(texts[i], win->title, sizeof(win->title)))
+      for (uint32_t i = 0; i < win->cold->cursor_pos; i++) {
+        if (!strncmp(texts[i], win->cold->title, sizeof(win->cold->title)))
           return i;
       }
       return kComboBoxError;
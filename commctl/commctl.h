@@ -18,6 +18,7 @@ result_t win_terminal(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
 
 // Terminal API functions
 const char* terminal_get_buffer(window_t *win);
+int terminal_get_scroll(window_t *win);
 
 // Console API functions
 void init_console(void);
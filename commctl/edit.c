@@ -18,16 +18,16 @@ extern window_t *_focused;
 result_t win_textedit(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   switch (msg) {
     case kWindowMessageCreate:
-      win->frame.w = MAX(win->frame.w, strwidth(win->title)+PADDING*2);
+      win->frame.w = MAX(win->frame.w, strwidth(win->cold->title)+PADDING*2);
       win->frame.h = MAX(win->frame.h, 13);
       return true;
     case kWindowMessagePaint:
       fill_rect(_focused == win?COLOR_FOCUSED:COLOR_PANEL_BG, win->frame.x-2, win->frame.y-2, win->frame.w+4, win->frame.h+4);
       draw_button(&win->frame, 1, 1, true);
-      draw_text_small(win->title, win->frame.x+PADDING, win->frame.y+PADDING, COLOR_TEXT_NORMAL);
+      draw_text_small(win->cold->title, win->frame.x+PADDING, win->frame.y+PADDING, COLOR_TEXT_NORMAL);
       if (_focused == win && win->editing) {
         fill_rect(COLOR_TEXT_NORMAL,
-                  win->frame.x+PADDING+strnwidth(win->title, win->cursor_pos),
+                  win->frame.x+PADDING+strnwidth(win->cold->title, win->cold->cursor_pos),
                   win->frame.y+PADDING,
                   2, 8);
       }
@@ -36,23 +36,23 @@ result_t win_textedit(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
       if (_focused == win) {
         invalidate_window(win);
         win->editing = true;
-        win->cursor_pos = 0;
-        for (int i = 0; i <= (int)strlen(win->title); i++) {
-          int x1 = win->frame.x+PADDING+strnwidth(win->title, i);
-          int x2 = win->frame.x+PADDING+strnwidth(win->title, win->cursor_pos);
+        win->cold->cursor_pos = 0;
+        for (int i = 0; i <= (int)strlen(win->cold->title); i++) {
+          int x1 = win->frame.x+PADDING+strnwidth(win->cold->title, i);
+          int x2 = win->frame.x+PADDING+strnwidth(win->cold->title, win->cold->cursor_pos);
           if (abs((int)LOWORD(wparam) - x1) < abs((int)LOWORD(wparam) - x2)) {
-            win->cursor_pos = i;
+            win->cold->cursor_pos = i;
           }
         }
       }
       return true;
     case kWindowMessageTextInput:
-      if (strlen(win->title) + strlen(lparam) < BUFFER_SIZE - 1) {
-        memmove(win->title + win->cursor_pos + 1,
-                win->title + win->cursor_pos,
-                strlen(win->title + win->cursor_pos) + 1);
-        win->title[win->cursor_pos] = *(char *)lparam; // Only handle 1-byte characters
-        win->cursor_pos++;
+      if (strlen(win->cold->title) + strlen(lparam) < BUFFER_SIZE - 1) {
+        memmove(win->cold->title + win->cold->cursor_pos + 1,
+                win->cold->title + win->cold->cursor_pos,
+                strlen(win->cold->title + win->cold->cursor_pos) + 1);
+        win->cold->title[win->cold->cursor_pos] = *(char *)lparam; // Only handle 1-byte characters
+        win->cold->cursor_pos++;
       }
       invalidate_window(win);
       return true;
@@ -60,7 +60,7 @@ result_t win_textedit(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
       switch (wparam) {
         case SDL_SCANCODE_RETURN:
           if (!win->editing) {
-            win->cursor_pos = (int)strlen(win->title);
+            win->cold->cursor_pos = (int)strlen(win->cold->title);
             win->editing = true;
           } else {
             send_message(get_root_window(win), kWindowMessageCommand, MAKEDWORD(win->id, kEditNotificationUpdate), win);
@@ -71,21 +71,21 @@ result_t win_textedit(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
           win->editing = false;
           break;
         case SDL_SCANCODE_BACKSPACE:
-          if (win->cursor_pos > 0 && win->editing) {
-            memmove(win->title + win->cursor_pos - 1,
-                    win->title + win->cursor_pos,
-                    strlen(win->title + win->cursor_pos) + 1);
-            win->cursor_pos--;
+          if (win->cold->cursor_pos > 0 && win->editing) {
+            memmove(win->cold->title + win->cold->cursor_pos - 1,
+                    win->cold->title + win->cold->cursor_pos,
+                    strlen(win->cold->title + win->cold->cursor_pos) + 1);
+            win->cold->cursor_pos--;
           }
           break;
         case SDL_SCANCODE_LEFT:
-          if (win->cursor_pos > 0 && win->editing) {
-            win->cursor_pos--;
+          if (win->cold->cursor_pos > 0 && win->editing) {
+            win->cold->cursor_pos--;
           }
           break;
         case SDL_SCANCODE_RIGHT:
-          if (win->cursor_pos < strlen(win->title) && win->editing) {
-            win->cursor_pos++;
+          if (win->cold->cursor_pos < strlen(win->cold->title) && win->editing) {
+            win->cold->cursor_pos++;
           }
           break;
         default:
@@ -16,12 +16,12 @@ extern window_t *_focused;
 result_t win_label(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   switch (msg) {
     case kWindowMessageCreate:
-      win->frame.w = MAX(win->frame.w, strwidth(win->title));
+      win->frame.w = MAX(win->frame.w, strwidth(win->cold->title));
       win->notabstop = true;
       return true;
     case kWindowMessagePaint:
-      draw_text_small(win->title, win->frame.x+1, win->frame.y+1+PADDING, COLOR_DARK_EDGE);
-      draw_text_small(win->title, win->frame.x, win->frame.y+PADDING, COLOR_TEXT_NORMAL);
+      draw_text_small(win->cold->title, win->frame.x+1, win->frame.y+1+PADDING, COLOR_DARK_EDGE);
+      draw_text_small(win->cold->title, win->frame.x, win->frame.y+PADDING, COLOR_TEXT_NORMAL);
       return true;
   }
   return false;
@@ -26,8 +26,8 @@ result_t win_list(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
       win->userdata = lparam;
       return true;
     case kWindowMessagePaint:
-      for (uint32_t i = 0; i < cb->cursor_pos; i++) {
-        if (i == win->cursor_pos) {
+      for (uint32_t i = 0; i < cb->cold->cursor_pos; i++) {
+        if (i == win->cold->cursor_pos) {
           fill_rect(COLOR_TEXT_NORMAL, 0, i*LIST_HEIGHT, win->frame.h, LIST_HEIGHT);
           draw_text_small(texts[i], LIST_X, i*LIST_HEIGHT+LIST_Y, COLOR_PANEL_BG);
         } else {
@@ -36,9 +36,9 @@ result_t win_list(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
       }
       return true;
     case kWindowMessageLeftButtonDown:
-      win->cursor_pos = HIWORD(wparam)/LIST_HEIGHT;
-      if (win->cursor_pos < cb->cursor_pos) {
-        strncpy(cb->title, texts[win->cursor_pos], sizeof(cb->title));
+      win->cold->cursor_pos = HIWORD(wparam)/LIST_HEIGHT;
+      if (win->cold->cursor_pos < cb->cold->cursor_pos) {
+        strncpy(cb->cold->title, texts[win->cold->cursor_pos], sizeof(cb->cold->title));
       }
       invalidate_window(win);
       return true;
@@ -47,7 +47,7 @@ result_t win_list(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
       destroy_window(win);
       return true;
     case LIST_SELITEM:
-      win->cursor_pos = wparam;
+      win->cold->cursor_pos = wparam;
       return true;
   }
   return false;
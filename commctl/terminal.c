@@ -55,6 +55,8 @@ typedef struct terminal_state_s {
   lua_State *L;          // Main Lua state (NULL if in command mode)
   lua_State *co;         // Coroutine for script execution (NULL if in command mode)
   text_buffer_t *textbuf;
+  text_layout_t layout;  // Line breaks of textbuf at the window's width
+  int scroll;            // Pixels of text scrolled off the top
   char input_buffer[256];
   bool waiting_for_input;
   bool process_finished;
@@ -255,6 +257,8 @@ static void cmd_clear(terminal_state_t *s) {
     s->textbuf->size = 0;
     s->textbuf->data[0] = '\0';
   }
+  reset_text_layout(&s->layout);
+  s->scroll = 0;
   f_strcat(&s->textbuf, "Terminal> ");
 }
 
@@ -296,6 +300,22 @@ static void process_command(terminal_state_t *s, const char *cmd) {
   }
 }
 
+// Area of the window the output text is drawn in
+static rect_t text_viewport(window_t *win) {
+  return (rect_t) {
+    WINDOW_PADDING,
+    WINDOW_PADDING,
+    win->frame.w - WINDOW_PADDING * 2,
+    win->frame.h - WINDOW_PADDING * 2
+  };
+}
+
+// Repaint only the input line at the bottom of the terminal
+static void invalidate_input_line(window_t *win) {
+  int y = win->frame.h - WINDOW_PADDING - CHAR_HEIGHT;
+  invalidate_rect(win, &(rect_t){ 0, y, win->frame.w, CHAR_HEIGHT });
+}
+
 // Public API: Get terminal buffer content
 // This function allows external code (including tests) to retrieve the current
 // terminal output buffer. It safely handles null pointers and invalid window types.
@@ -309,13 +329,20 @@ const char* terminal_get_buffer(window_t *win) {
   return s->textbuf->data;
 }
 
+// Public API: Pixels of terminal output scrolled off the top
+int terminal_get_scroll(window_t *win) {
+  if (!win || !win->userdata || win->proc != win_terminal) return 0;
+  return ((terminal_state_t *)win->userdata)->scroll;
+}
+
 result_t win_terminal(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   terminal_state_t *s = (terminal_state_t *)win->userdata;
   
   switch (msg) {
     case kWindowMessageCreate: {
-      s = allocate_window_data(win, sizeof(terminal_state_t));
+      s = alloc_window_memory(win, sizeof(terminal_state_t));
       if (!s) return false;
+      win->userdata = s;
       
       win->flags |= WINDOW_VSCROLL;
       
@@ -378,7 +405,7 @@ result_t win_terminal(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
       } else if (wparam == SDL_SCANCODE_BACKSPACE) {
         if (strlen(s->input_buffer)) {
           s->input_buffer[strlen(s->input_buffer) - 1] = '\0';
-          invalidate_window(win);
+          invalidate_input_line(win);
         }
         return true;
       } else {
@@ -391,7 +418,7 @@ result_t win_terminal(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
         if (strlen(s->input_buffer) < sizeof(s->input_buffer) - 1) {
           strcat(s->input_buffer, (char[]){*(char*)lparam,0});
         }
-        invalidate_window(win);
+        invalidate_input_line(win);
         return true;
       } else {
         return false;
@@ -400,25 +427,35 @@ result_t win_terminal(window_t *win, uint32_t msg, uint32_t wparam, void *lparam
     case kWindowMessageDestroy:
       if (s) {
         free_text_buffer(&s->textbuf);
+        free_text_layout(&s->layout);
         if (s->L) lua_close(s->L);
-        free(s);
+        free_window_memory(s);
         win->userdata = NULL;
       }
       return true;
       
+    case kWindowMessageWheel: {
+      if (!s) return false;
+      // The output can outgrow the window's 16-bit scroll, so the terminal
+      // keeps its own offset and the window itself never scrolls
+      rect_t viewport = text_viewport(win);
+      update_text_layout(&s->layout, s->textbuf->data, s->textbuf->size, viewport.w);
+      int limit = MAX(0, text_layout_height(&s->layout) - viewport.h);
+      s->scroll = MAX(0, MIN(s->scroll - (int16_t)HIWORD(wparam), limit));
+      invalidate_window(win);
+      return true;
+    }
+      
     case kWindowMessagePaint: {
       if (!s) return false;
       
-      rect_t viewport = {
-        WINDOW_PADDING, 
-        WINDOW_PADDING,
-        win->frame.w - WINDOW_PADDING * 2,
-        win->frame.h - WINDOW_PADDING * 2
-      };
-      draw_text_wrapped(s->textbuf->data, &viewport, COLOR_TEXT_NORMAL);
+      // Only the lines inside the viewport are drawn
+      rect_t viewport = text_viewport(win);
+      update_text_layout(&s->layout, s->textbuf->data, s->textbuf->size, viewport.w);
+      draw_text_layout(&s->layout, s->textbuf->data, &viewport, s->scroll, COLOR_TEXT_NORMAL);
       
       if (s->waiting_for_input && !s->process_finished) {
-        int y = win->frame.h - WINDOW_PADDING - CHAR_HEIGHT + win->scroll[1];
+        int y = win->frame.h - WINDOW_PADDING - CHAR_HEIGHT;
         draw_text_small(s->input_buffer, WINDOW_PADDING, y, COLOR_TEXT_NORMAL);
         draw_icon8(ICON_CURSOR, WINDOW_PADDING + strwidth(s->input_buffer), y, COLOR_TEXT_NORMAL);
       }
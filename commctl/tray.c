@@ -21,9 +21,9 @@ extern window_t *windows;
 result_t win_button(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
 
 void create_button(window_t *tray, window_t *window) {
-  rect_t r = { tray->cursor_pos, 2, 0, 12 };
-  window_t *button = create_window(window->title, 0, &r, tray, win_button, window);
-  tray->cursor_pos += button->frame.w + SPACING;
+  rect_t r = { tray->cold->cursor_pos, 2, 0, 12 };
+  window_t *button = create_window(window->cold->title, 0, &r, tray, win_button, window);
+  tray->cold->cursor_pos += button->frame.w + SPACING;
   button->userdata = window;
 }
 
@@ -37,29 +37,20 @@ static void on_win_destroyed(window_t *win, uint32_t msg, uint32_t wparam, void
   if (!win->parent) {
     window_t *tray = userdata;
     window_t *button = 0;
-    if (!tray->children) {
-      return;
-    }    
-    if (win == tray->children->userdata) {
-      button = tray->children;
-      tray->children = button->next;
-    } else {
-      for (window_t *b = tray->children, *n = b->next; n; b = n, n = n->next) {
-        if (n->userdata == win) {
-          button = n;
-          b->next = n->next;
-          break;
-        }
+    for (window_t *b = tray->children; b; b = b->next) {
+      if (b->userdata == win) {
+        button = b;
+        break;
       }
     }
     if (!button) {
-//      printf("Can't find button for window %s\n", win->title);
+//      printf("Can't find button for window %s\n", win->cold->title);
       return;
     }
     for (window_t *it = button->next; it; it = it->next) {
       it->frame.x -= button->frame.w + SPACING;
     }
-    tray->cursor_pos -= button->frame.w + SPACING;
+    tray->cold->cursor_pos -= button->frame.w + SPACING;
     destroy_window(button);
     invalidate_window(tray);
   }
@@ -68,7 +59,7 @@ static void on_win_destroyed(window_t *win, uint32_t msg, uint32_t wparam, void
 result_t win_tray(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   switch (msg) {
     case kWindowMessageCreate:
-      win->cursor_pos = 22;
+      win->cold->cursor_pos = 22;
       win->frame = (rect_t){0,ui_get_system_metrics(kSystemMetricScreenHeight)-TRAY_HEIGHT,ui_get_system_metrics(kSystemMetricScreenWidth),TRAY_HEIGHT};
       register_window_hook(kWindowMessageCreate, on_win_created, win);
       register_window_hook(kWindowMessageDestroy, on_win_destroyed, win);
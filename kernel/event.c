@@ -9,6 +9,7 @@
 
 #include "../user/user.h"
 #include "../user/messages.h"
+#include "software.h"
 
 // External references
 extern bool running;
@@ -72,44 +73,19 @@ window_t* find_prev_tab_stop(window_t* win) {
 // Move window to top of Z-order
 void move_to_top(window_t* _win) {
   extern window_t *get_root_window(window_t *window);
-  extern void post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
   extern void invalidate_window(window_t *win);
+  extern void update_window_visibility(window_t *win, rect_t const *old);
+  extern void invalidate_hit_test(window_t *win);
+  extern bool raise_top_level(window_t *win);
   
   window_t *win = get_root_window(_win);
-  post_message(win, kWindowMessageRefreshStencil, 0, NULL);
   invalidate_window(win);
   
-  if (win->flags&WINDOW_ALWAYSINBACK)
-    return;
-  
-  window_t **head = &windows, *p = NULL, *n = *head;
-  
-  // Find the node `win` in the list
-  while (n != win) {
-    p = n;
-    n = n->next;
-    if (!n) return;  // If `win` is not found, exit
-  }
-  
-  // Remove the node `win` from the list
-  if (p) p->next = win->next;
-  else *head = win->next;  // If `win` is at the head, update the head
-  
-  // If `win` was the only node, just re-add it and return
-  if (!*head) {
-    *head = win;
-    win->next = NULL;
-    return;
+  // Windows stay within their band, so the desktop remains in the back
+  if (raise_top_level(win)) {
+    invalidate_hit_test(win);
+    update_window_visibility(win, NULL);
   }
-  
-  // Find the tail of the list
-  window_t *tail = *head;
-  while (tail->next)
-    tail = tail->next;
-  
-  // Append `win` to the end of the list
-  tail->next = win;
-  win->next = NULL;
 }
 
 // Dispatch SDL event to window system
@@ -119,6 +95,21 @@ void dispatch_message(SDL_Event *evt) {
     case SDL_QUIT:
       running = false;
       break;
+    case SDL_WINDOWEVENT:
+      // The software framebuffer keeps its size; SDL scales it on present
+      if (evt->window.event == SDL_WINDOWEVENT_SIZE_CHANGED && !sw_enabled()) {
+        extern SDL_Window *window;
+        int w, h;
+        SDL_GL_GetDrawableSize(window, &w, &h);
+        R_SetDrawableSize(w, h);
+        // A new persistent frame starts out empty
+        if (R_FrameEnabled() && R_FrameInit(w, h)) {
+          for (window_t *it = windows; it; it = it->next) {
+            invalidate_window(it);
+          }
+        }
+      }
+      break;
     case SDL_TEXTINPUT:
       send_message(_focused, kWindowMessageTextInput, 0, evt->text.text);
       break;
@@ -275,7 +266,13 @@ void dispatch_message(SDL_Event *evt) {
   }
 }
 
-// Get next SDL event
+// Get next SDL event. With no window messages queued there is nothing to
+// repaint, so this sleeps until input arrives. Once the app stops running it
+// only polls, so event loops get back to checking running.
 int get_message(SDL_Event *evt) {
-  return SDL_PollEvent(evt);
+  extern bool has_pending_messages(void);
+  if (has_pending_messages() || !running) {
+    return SDL_PollEvent(evt);
+  }
+  return SDL_WaitEvent(evt);
 }
@@ -9,6 +9,7 @@
 #include "../user/user.h"
 #include "../commctl/commctl.h"
 #include "kernel.h"
+#include "software.h"
 
 // Global SDL objects
 SDL_Window* window = NULL;
@@ -23,25 +24,46 @@ GLuint ui_white_texture = 0;
 // Initialize the internal white texture
 void init_ui_white_texture(void) {
   if (ui_white_texture == 0) {
-    glGenTextures(1, &ui_white_texture);
-    glBindTexture(GL_TEXTURE_2D, ui_white_texture);
     uint32_t white_pixel = 0xFFFFFFFF;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white_pixel);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    ui_white_texture = R_CreateTexture(&(R_Texture) { .width = 1, .height = 1, .format = GL_RGBA }, &white_pixel);
   }
 }
 
 void shutdown_white_texture(void) {
-  SAFE_DELETE_N(ui_white_texture, glDeleteTextures);
+  R_DeleteTexture(&ui_white_texture);
+}
+
+// Initialize window and software framebuffer (no OpenGL context)
+static bool ui_init_software_window(const char *title, int width, int height) {
+  window = SDL_CreateWindow(title,
+                            SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                            width, height,
+                            SDL_WINDOW_INPUT_FOCUS);
+  if (!window) {
+    printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+  
+  // Render at the logical resolution and let SDL scale it up on present
+  if (!sw_init(window, width / UI_WINDOW_SCALE, height / UI_WINDOW_SCALE)) {
+    printf("Software framebuffer could not be created!\n");
+    SDL_DestroyWindow(window);
+    window = NULL;
+    return false;
+  }
+  R_ResetState();
+  R_SetDrawableSize(width / UI_WINDOW_SCALE, height / UI_WINDOW_SCALE);
+  
+  printf("Renderer    : software\n");
+  
+  return true;
 }
 
 // Initialize window and OpenGL context
 static bool ui_init_window(const char *title, int width, int height) {
   // Set OpenGL attributes before creating window
-  SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-  SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 0);
+  SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
@@ -99,6 +121,13 @@ static bool ui_init_window(const char *title, int width, int height) {
   }
 #endif
   
+  // Start from a known GL state and remember the drawable size so
+  // viewport math doesn't have to query SDL every frame
+  int drawable_w, drawable_h;
+  SDL_GL_GetDrawableSize(window, &drawable_w, &drawable_h);
+  R_ResetState();
+  R_SetDrawableSize(drawable_w, drawable_h);
+  
   printf("GL_VERSION  : %s\n", glGetString(GL_VERSION));
   printf("GLSL_VERSION: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
   
@@ -126,18 +155,34 @@ bool ui_init_graphics(int flags, const char *title, int width, int height) {
     return false;
   }
   // Use ui_init_window to create window and context
-  if (!ui_init_window(title, width * UI_WINDOW_SCALE, height * UI_WINDOW_SCALE)) {
-    SDL_Quit();
-    return false;
+  if (flags & UI_INIT_SOFTWARE) {
+    if (!ui_init_software_window(title, width * UI_WINDOW_SCALE, height * UI_WINDOW_SCALE)) {
+      SDL_Quit();
+      return false;
+    }
+  } else {
+    if (!ui_init_window(title, width * UI_WINDOW_SCALE, height * UI_WINDOW_SCALE)) {
+      SDL_Quit();
+      return false;
+    }
+    
+    // Enable VSync
+    SDL_GL_SetSwapInterval(1);
   }
-
-  // Enable VSync
-  SDL_GL_SetSwapInterval(1);
   
   ui_init_prog();
   
   init_ui_white_texture();
 
+  enable_compositing(flags & UI_INIT_COMPOSITE);
+
+  // Composited frames are redrawn in full and can go straight to the back buffer
+  if (!(flags & UI_INIT_SOFTWARE) && !is_compositing()) {
+    int w, h;
+    R_GetDrawableSize(&w, &h);
+    R_FrameInit(w, h);
+  }
+
   init_console();
   
   if (flags & UI_INIT_DESKTOP) {
@@ -178,17 +223,35 @@ void ui_shutdown_graphics(void) {
   extern void cleanup_all_hooks(void);
   cleanup_all_hooks();
   
+  // Release the message queue
+  extern void cleanup_message_queue(void);
+  cleanup_message_queue();
+  
+  // Free the window and control state pools
+  extern void cleanup_window_pools(void);
+  cleanup_window_pools();
+  
+  // Free the window handle table
+  extern void cleanup_window_handles(void);
+  cleanup_window_handles();
+  
   // Shutdown joystick if it was initialized
   if (ui_joystick_available()) {
     ui_joystick_shutdown();
   }
   
+  enable_compositing(false);
+
+  R_FrameShutdown();
+
   ui_shutdown_prog();
   
   shutdown_white_texture();
 
   shutdown_console();
 
+  sw_shutdown();
+
   if (ctx) {
     SDL_GL_DeleteContext(ctx);
     ctx = NULL;
@@ -7,6 +7,8 @@
 
 #define UI_INIT_DESKTOP 0x01000000u
 #define UI_INIT_TRAY 0x02000000u
+#define UI_INIT_SOFTWARE 0x04000000u  // Render on the CPU instead of OpenGL
+#define UI_INIT_COMPOSITE 0x08000000u // Paint top-level windows offscreen and composite them
 
 #define UI_WINDOW_SCALE 2
 
@@ -36,10 +38,62 @@ void ui_delay(unsigned int milliseconds);
 int get_sprite_prog(void);
 int get_sprite_vao(void);
 
+// Batched sprite - one 16-byte instance per quad
+typedef struct {
+  int16_t x, y, w, h;     // Screen rect
+  uint8_t u, v, uw, vh;   // Source rect in texels; uw = vh = 0 samples the whole texture
+  uint32_t col;           // RGBA color
+} sprite_instance_t;
+
+// Batched glyph - one 8-byte instance per character. The shader finds the
+// glyph's cell in the font atlas: GLYPH_CELL_SIZE texels square, GLYPHS_PER_ROW
+// cells to a row. Colors are slots in a palette shared by the batch.
+#define GLYPH_CELL_SIZE 8
+#define GLYPHS_PER_ROW 16
+#define GLYPH_PALETTE_SIZE 16
+typedef struct {
+  int16_t x, y;           // Top-left on screen
+  uint8_t glyph;          // Atlas cell
+  uint8_t left, width;    // Inked columns within the cell
+  uint8_t color;          // Palette slot returned by reserve_glyphs
+} glyph_instance_t;
+
+// Sprite batching - quads are queued and drawn together until the
+// texture, viewport, scissor or projection changes
+sprite_instance_t *reserve_sprites(int tex, size_t max_count);
+void commit_sprites(size_t count);
+
+// Glyph batching - like sprites, for long runs of text. Queueing sprites
+// flushes pending glyphs and vice versa, so draws keep their order.
+glyph_instance_t *reserve_glyphs(int tex, size_t max_count, uint32_t col, uint8_t *color);
+void commit_glyphs(size_t count);
+// Source rect values must fit in 0..255 or the quad is dropped; the screen
+// rect is clipped to the int16_t range
+void push_sprite_rect(int tex, int x, int y, int w, int h,
+                      int u, int v, int uw, int vh, uint32_t col);
+void push_solid_rect(int x, int y, int w, int h, uint32_t col);
+void set_solid_texel(int tex, int u, int v);
+void flush_sprites(void);
+
 void push_sprite_args(int tex, int x, int y, int w, int h, float alpha);
+void draw_surface(int tex, int x, int y, int w, int h);
 void set_projection(int x, int y, int w, int h);
+void set_sprite_viewport(int x, int y, int w, int h);
+void set_sprite_scissor(int x, int y, int w, int h);
+void set_sprite_clip(int x, int y, int w, int h);
+void add_sprite_clip(int x, int y, int w, int h);
+void clear_sprite_clip(void);
 float *get_sprite_matrix(void);
 
+// Display lists - quads and state changes recorded while a window paints,
+// so the window can be redrawn later without running its procedure
+typedef struct display_list_s display_list_t;
+display_list_t *begin_display_list(display_list_t *list);
+void end_display_list(void);
+bool is_recording_display_list(void);
+void replay_display_list(display_list_t const *list);
+void free_display_list(display_list_t *list);
+
 // Global SDL objects
 extern SDL_Window* window;
 extern SDL_GLContext ctx;
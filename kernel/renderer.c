@@ -1,5 +1,6 @@
 #include "../ui.h"
 #include "../user/gl_compat.h"
+#include "software.h"
 
 #include <cglm/cglm.h>
 #include <cglm/struct.h>
@@ -24,11 +25,86 @@ wall_vertex_t sprite_verts[] = {
   {1, 0, 0, 1, 0, 0, 0, 0, -1}, // bottom right
 };
 
+#define SPRITE_BATCH_INITIAL 1024  // Initial batch capacity in quads
+#define GLYPH_BATCH_MAX 16384      // Glyphs queued before the batch is drawn
+
+// Unit quad expanded by the batch shader for every instance
+static const GLubyte quad_corners[][4] = { {0, 0}, {0, 1}, {1, 0}, {1, 1} };
+static const GLushort quad_indices[] = { 0, 1, 2, 1, 3, 2 };
+
+// Sprite batch - quads collected between state changes
+typedef struct {
+  GLuint program;              // Instanced quad shader
+  struct {
+    GLint projection, alpha, tex0;
+  } loc;
+  R_Mesh mesh;                 // Unit quad plus a streamed instance buffer
+  sprite_instance_t *items;    // CPU-side instance stream
+  size_t count;                // Quads queued since last flush
+  size_t capacity;             // Allocated quads
+  int tex;                     // Texture shared by all queued quads
+  int solid_tex;               // Texture holding an opaque white texel
+  int solid_u, solid_v;        // Texel used for solid fills
+} sprite_batch_t;
+
+// Glyph batch - text queued as 8-byte instances between state changes
+typedef struct {
+  GLuint program;              // Instanced glyph shader
+  struct {
+    GLint projection, alpha, tex0, palette;
+  } loc;
+  R_Mesh mesh;                 // Unit quad plus a streamed instance buffer
+  glyph_instance_t *items;
+  size_t count;
+  size_t capacity;
+  int tex;                     // Font atlas
+  uint32_t palette[GLYPH_PALETTE_SIZE];
+  int num_colors;
+} glyph_batch_t;
+
+// Display list command
+typedef enum {
+  kDisplaySprites,     // Instance range sampling tex
+  kDisplayOutline,     // draw_rect_ex outline
+  kDisplayProjection,
+  kDisplayViewport,
+  kDisplayScissor,
+} display_op_t;
+
+typedef struct {
+  display_op_t op;
+  int tex;
+  int rect[4];          // Outline, projection, viewport or scissor rect
+  float alpha;          // Outline alpha
+  uint32_t first, count;
+} display_cmd_t;
+
+struct display_list_s {
+  display_cmd_t *cmds;
+  size_t num_cmds, max_cmds;
+  sprite_instance_t *items;
+  size_t num_items, max_items;
+};
+
 // Sprite system state
 typedef struct {
   GLuint program;        // Shader program
+  struct {
+    GLint projection, offset, scale, alpha, tex0;
+  } loc;                 // Uniform locations, looked up once at link time
   R_Mesh mesh;           // Sprite mesh for drawing quads
   mat4 projection;       // Orthographic projection matrix
+  mat4 view;             // Projection set by set_projection
+  sprite_batch_t batch;  // Pending batched quads
+  glyph_batch_t glyphs;  // Pending batched glyphs; only one batch holds draws
+  display_list_t *recording;  // Display list capturing draws, if any
+  size_t record_mark;    // Queued quads that predate the recording
+  size_t glyph_mark;     // Queued glyphs that predate the recording
+  bool clipped;          // Draws are limited to the clip rects
+  int (*clips)[4];       // Clip rects in GL window coordinates
+  int num_clips, max_clips;
+  bool scissored;        // set_sprite_scissor was called
+  int scissor[4];        // Last scissor rect requested
 } renderer_system_t;
 
 renderer_system_t g_ref = {0};
@@ -49,6 +125,44 @@ const char* sprite_vs_src = "#version 150 core\n"
 "  gl_Position = projection * vec4(position * scale + offset, 0.0, 1.0);\n"
 "}";
 
+// Batch shader: expands the unit quad by each instance's rect. Source
+// rects are in texels; an empty one samples the whole texture.
+const char* batch_vs_src = "#version 150 core\n"
+"in vec2 corner;\n"
+"in vec4 rect;\n"
+"in vec4 uvrect;\n"
+"in vec4 color;\n"
+"out vec2 tex;\n"
+"out vec4 col;\n"
+"uniform mat4 projection;\n"
+"uniform sampler2D tex0;\n"
+"void main() {\n"
+"  vec4 uv = vec4(0.0, 0.0, 1.0, 1.0);\n"
+"  if (uvrect.z > 0.0 || uvrect.w > 0.0) uv = uvrect / vec2(textureSize(tex0, 0)).xyxy;\n"
+"  col = color;\n"
+"  tex = uv.xy + corner * uv.zw;\n"
+"  gl_Position = projection * vec4(rect.xy + corner * rect.zw, 0.0, 1.0);\n"
+"}";
+
+// Glyph shader: expands the unit quad over the glyph's inked columns of its
+// atlas cell and looks its color up in the batch palette
+const char* glyph_vs_src = "#version 150 core\n"
+"in vec2 corner;\n"
+"in vec2 position;\n"
+"in vec4 cell;\n"
+"out vec2 tex;\n"
+"out vec4 col;\n"
+"uniform mat4 projection;\n"
+"uniform sampler2D tex0;\n"
+"uniform vec4 palette[16];\n"
+"void main() {\n"
+"  vec2 size = vec2(cell.z, 8.0);\n"
+"  vec2 origin = vec2(mod(cell.x, 16.0) * 8.0 + cell.y, floor(cell.x / 16.0) * 8.0);\n"
+"  col = palette[int(cell.w)];\n"
+"  tex = (origin + corner * size) / vec2(textureSize(tex0, 0));\n"
+"  gl_Position = projection * vec4(position + corner * size, 0.0, 1.0);\n"
+"}";
+
 const char* sprite_fs_src = "#version 150 core\n"
 "in vec2 tex;\n"
 "in vec4 col;\n"
@@ -90,46 +204,114 @@ int get_sprite_vao(void) {
   return g_ref.mesh.vao;
 }
 
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader,
+                           const char **attribs, int attrib_count) {
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  for (int i = 0; i < attrib_count; i++) {
+    glBindAttribLocation(program, i, attribs[i]);
+  }
+  glLinkProgram(program);
+  return program;
+}
+
 // Initialize the sprite system
 bool ui_init_prog(void) {
+  // Create orthographic projection matrix for screen-space rendering
+  int width, height;
+  SDL_GetWindowSize(window, &width, &height);
+  //  float scale = (float)height / DOOM_HEIGHT;
+  //  float render_width = DOOM_WIDTH * scale;
+  //  float offset_x = (width - render_width) / (2.0f * scale);
+  //  black_bars = offset_x;
+  //  glm_ortho(-offset_x, DOOM_WIDTH+offset_x, DOOM_HEIGHT, 0, -1, 1, g_ref.projection);
+  screen_width = width / UI_WINDOW_SCALE;
+  screen_height = height / UI_WINDOW_SCALE;
+  glm_ortho(0, screen_width, ui_get_system_metrics(kSystemMetricScreenHeight), 0, -1, 1, g_ref.projection);
+  
+  // The software backend needs no shaders or buffers
+  if (sw_enabled()) {
+    return true;
+  }
+  
   // Create shader program
   GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, sprite_vs_src);
   GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, sprite_fs_src);
   
-  g_ref.program = glCreateProgram();
-  glAttachShader(g_ref.program, vertex_shader);
-  glAttachShader(g_ref.program, fragment_shader);
-  glBindAttribLocation(g_ref.program, 0, "position");
-  glBindAttribLocation(g_ref.program, 1, "texcoord");
-  glBindAttribLocation(g_ref.program, 2, "color");
-  glLinkProgram(g_ref.program);
+  GLuint batch_shader = compile_shader(GL_VERTEX_SHADER, batch_vs_src);
+  GLuint glyph_shader = compile_shader(GL_VERTEX_SHADER, glyph_vs_src);
+  
+  g_ref.program = link_program(vertex_shader, fragment_shader,
+                               (const char*[]) { "position", "texcoord", "color" }, 3);
+  g_ref.batch.program = link_program(batch_shader, fragment_shader,
+                                     (const char*[]) { "corner", "rect", "uvrect", "color" }, 4);
+  g_ref.glyphs.program = link_program(glyph_shader, fragment_shader,
+                                      (const char*[]) { "corner", "position", "cell" }, 3);
+
+  g_ref.loc.projection = glGetUniformLocation(g_ref.program, "projection");
+  g_ref.loc.offset = glGetUniformLocation(g_ref.program, "offset");
+  g_ref.loc.scale = glGetUniformLocation(g_ref.program, "scale");
+  g_ref.loc.alpha = glGetUniformLocation(g_ref.program, "alpha");
+  g_ref.loc.tex0 = glGetUniformLocation(g_ref.program, "tex0");
+  R_UseProgram(g_ref.program);
+  R_Uniform1i(g_ref.loc.tex0, 0);
+  
+  g_ref.batch.loc.projection = glGetUniformLocation(g_ref.batch.program, "projection");
+  g_ref.batch.loc.alpha = glGetUniformLocation(g_ref.batch.program, "alpha");
+  g_ref.batch.loc.tex0 = glGetUniformLocation(g_ref.batch.program, "tex0");
+  R_UseProgram(g_ref.batch.program);
+  R_Uniform1i(g_ref.batch.loc.tex0, 0);
+  R_Uniform1f(g_ref.batch.loc.alpha, 1);
+  
+  g_ref.glyphs.loc.projection = glGetUniformLocation(g_ref.glyphs.program, "projection");
+  g_ref.glyphs.loc.alpha = glGetUniformLocation(g_ref.glyphs.program, "alpha");
+  g_ref.glyphs.loc.tex0 = glGetUniformLocation(g_ref.glyphs.program, "tex0");
+  g_ref.glyphs.loc.palette = glGetUniformLocation(g_ref.glyphs.program, "palette");
+  R_UseProgram(g_ref.glyphs.program);
+  R_Uniform1i(g_ref.glyphs.loc.tex0, 0);
+  R_Uniform1f(g_ref.glyphs.loc.alpha, 1);
   
   // Initialize mesh for sprite rendering using Renderer API
   // Vertex attribute layout: 0 = Position, 1 = UV, 2 = Color
   R_VertexAttrib attribs[] = {
-    {0, 3, GL_SHORT, GL_FALSE, offsetof(wall_vertex_t, x)},      // Position (x, y, z)
-    {1, 2, GL_SHORT, GL_FALSE, offsetof(wall_vertex_t, u)},      // UV
-    {2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(wall_vertex_t, color)} // Color
+    {0, 3, GL_SHORT, GL_FALSE, offsetof(wall_vertex_t, x), 0},      // Position (x, y, z)
+    {1, 2, GL_SHORT, GL_FALSE, offsetof(wall_vertex_t, u), 0},      // UV
+    {2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(wall_vertex_t, color), 0} // Color
   };
   R_MeshInit(&g_ref.mesh, attribs, 3, sizeof(wall_vertex_t), GL_TRIANGLE_FAN);
   
   // Upload static sprite vertex data
   R_MeshUpload(&g_ref.mesh, sprite_verts, 4);
+
+  // Batched quads: an indexed unit quad drawn once per streamed instance
+  R_VertexAttrib corner_attribs[] = {
+    {0, 2, GL_UNSIGNED_BYTE, GL_FALSE, 0, 0},                                // Corner
+  };
+  R_VertexAttrib instance_attribs[] = {
+    {1, 4, GL_SHORT, GL_FALSE, offsetof(sprite_instance_t, x), 1},           // Rect
+    {2, 4, GL_UNSIGNED_BYTE, GL_FALSE, offsetof(sprite_instance_t, u), 1},   // Source rect
+    {3, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(sprite_instance_t, col), 1},  // Color
+  };
+  R_MeshInit(&g_ref.batch.mesh, corner_attribs, 1, sizeof(quad_corners[0]), GL_TRIANGLES);
+  R_MeshUpload(&g_ref.batch.mesh, quad_corners, 4);
+  R_MeshUploadIndices(&g_ref.batch.mesh, quad_indices, 6);
+  R_MeshInitInstances(&g_ref.batch.mesh, instance_attribs, 3, sizeof(sprite_instance_t), true);
+  
+  // Glyphs: the same quad, expanded by 8-byte instances
+  R_VertexAttrib glyph_attribs[] = {
+    {1, 2, GL_SHORT, GL_FALSE, offsetof(glyph_instance_t, x), 1},            // Position
+    {2, 4, GL_UNSIGNED_BYTE, GL_FALSE, offsetof(glyph_instance_t, glyph), 1}, // Cell, columns, color
+  };
+  R_MeshInit(&g_ref.glyphs.mesh, corner_attribs, 1, sizeof(quad_corners[0]), GL_TRIANGLES);
+  R_MeshUpload(&g_ref.glyphs.mesh, quad_corners, 4);
+  R_MeshUploadIndices(&g_ref.glyphs.mesh, quad_indices, 6);
+  R_MeshInitInstances(&g_ref.glyphs.mesh, glyph_attribs, 2, sizeof(glyph_instance_t), true);
   
-  // Create orthographic projection matrix for screen-space rendering
-  int width, height;
-  SDL_GetWindowSize(SDL_GL_GetCurrentWindow(), &width, &height);
-  //  float scale = (float)height / DOOM_HEIGHT;
-  //  float render_width = DOOM_WIDTH * scale;
-  //  float offset_x = (width - render_width) / (2.0f * scale);
-  //  black_bars = offset_x;
-  //  glm_ortho(-offset_x, DOOM_WIDTH+offset_x, DOOM_HEIGHT, 0, -1, 1, g_ref.projection);
-  screen_width = width / UI_WINDOW_SCALE;
-  screen_height = height / UI_WINDOW_SCALE;
-  glm_ortho(0, screen_width, ui_get_system_metrics(kSystemMetricScreenHeight), 0, -1, 1, g_ref.projection);
-    
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
+  glDeleteShader(batch_shader);
+  glDeleteShader(glyph_shader);
   
   return true;
 }
@@ -137,25 +319,467 @@ bool ui_init_prog(void) {
 void ui_shutdown_prog(void) {
   // Delete shader program and buffers
   SAFE_DELETE(g_ref.program, glDeleteProgram);
+  SAFE_DELETE(g_ref.batch.program, glDeleteProgram);
+  SAFE_DELETE(g_ref.glyphs.program, glDeleteProgram);
+  R_ResetState();
   R_MeshDestroy(&g_ref.mesh);
+  R_MeshDestroy(&g_ref.batch.mesh);
+  R_MeshDestroy(&g_ref.glyphs.mesh);
+  R_StreamShutdown();
+  SAFE_DELETE(g_ref.batch.items, free);
+  memset(&g_ref.batch, 0, sizeof(g_ref.batch));
+  SAFE_DELETE(g_ref.glyphs.items, free);
+  memset(&g_ref.glyphs, 0, sizeof(g_ref.glyphs));
+  SAFE_DELETE(g_ref.clips, free);
+  g_ref.clipped = false;
+  g_ref.num_clips = g_ref.max_clips = 0;
+}
+
+static void record_sprites(int tex, sprite_instance_t const *items, size_t count);
+
+// Number of times a draw is issued: once per clip rect, or once if unclipped
+static int clip_passes(void) {
+  return g_ref.clipped ? g_ref.num_clips : 1;
+}
+
+// Scissor the given pass to its clip rect within the requested scissor.
+// Returns false if nothing of the pass is left.
+static bool begin_clip_pass(int pass) {
+  if (!g_ref.clipped) return true;
+  int const *c = g_ref.clips[pass];
+  int x1 = c[0], y1 = c[1], x2 = c[0] + c[2], y2 = c[1] + c[3];
+  if (g_ref.scissored) {
+    int const *r = g_ref.scissor;
+    x1 = MAX(x1, r[0]);
+    y1 = MAX(y1, r[1]);
+    x2 = MIN(x2, r[0] + r[2]);
+    y2 = MIN(y2, r[1] + r[3]);
+  }
+  if (x1 >= x2 || y1 >= y2) return false;
+  R_SetCap(GL_SCISSOR_TEST, true);
+  R_Scissor(x1, y1, x2 - x1, y2 - y1);
+  return true;
+}
+
+// Standard alpha blending. Alpha accumulates as coverage, so a transparent
+// offscreen surface ends up holding premultiplied colors.
+static void set_sprite_blend(void) {
+  R_SetCap(GL_BLEND, true);
+  R_BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  // Disable depth testing for UI elements
+  R_SetCap(GL_DEPTH_TEST, false);
+}
+
+// The quad a glyph covers, for the software backend and display lists
+static sprite_instance_t glyph_sprite(glyph_instance_t const *g, uint32_t const *palette) {
+  int u = (g->glyph % GLYPHS_PER_ROW) * GLYPH_CELL_SIZE + g->left;
+  int v = (g->glyph / GLYPHS_PER_ROW) * GLYPH_CELL_SIZE;
+  return (sprite_instance_t) {
+    g->x, g->y, g->width, GLYPH_CELL_SIZE,
+    u, v, g->width, GLYPH_CELL_SIZE, palette[g->color]
+  };
+}
+
+// Expand glyphs into quads a chunk at a time and hand each chunk to draw
+static void expand_glyphs(glyph_batch_t const *b, size_t first,
+                          void (*draw)(int tex, sprite_instance_t const *items, size_t count)) {
+  sprite_instance_t chunk[256];
+  for (size_t i = first; i < b->count; ) {
+    size_t n = 0;
+    for (; n < 256 && i < b->count; n++, i++) {
+      chunk[n] = glyph_sprite(&b->items[i], b->palette);
+    }
+    draw(b->tex, chunk, n);
+  }
+}
+
+static void sw_draw_glyph_chunk(int tex, sprite_instance_t const *items, size_t count) {
+  sw_draw_sprites(tex, items, count);
+}
+
+// Draw all queued glyphs with the current GL state
+static void flush_glyphs(void) {
+  glyph_batch_t *b = &g_ref.glyphs;
+  if (b->count == 0) return;
+  // Display lists hold quads, so recorded glyphs replay through the sprite batch
+  if (g_ref.recording && b->count > g_ref.glyph_mark) {
+    expand_glyphs(b, g_ref.glyph_mark, record_sprites);
+  }
+  g_ref.glyph_mark = 0;
+  bool uploaded = false;
+  for (int i = 0; i < clip_passes(); i++) {
+    if (!begin_clip_pass(i)) continue;
+    if (sw_enabled()) {
+      expand_glyphs(b, 0, sw_draw_glyph_chunk);
+    } else if (uploaded) {
+      R_MeshRedrawInstanced(&b->mesh, b->count);
+    } else {
+      GLfloat palette[GLYPH_PALETTE_SIZE][4];
+      for (int c = 0; c < b->num_colors; c++) {
+        for (int k = 0; k < 4; k++) {
+          palette[c][k] = ((b->palette[c] >> (k * 8)) & 0xff) / 255.0f;
+        }
+      }
+      R_UseProgram(b->program);
+      R_BindTexture(b->tex);
+      R_UniformMatrix4fv(b->loc.projection, g_ref.view[0]);
+      R_Uniform4fv(b->loc.palette, b->num_colors, palette[0]);
+      set_sprite_blend();
+      R_MeshDrawInstanced(&b->mesh, b->items, b->count);
+      uploaded = true;
+    }
+  }
+  b->count = 0;
+  b->num_colors = 0;
+}
+
+// Draw all queued quads and glyphs with the current GL state
+void flush_sprites(void) {
+  flush_glyphs();
+  sprite_batch_t *b = &g_ref.batch;
+  if (b->count == 0) return;
+  if (g_ref.recording && b->count > g_ref.record_mark) {
+    record_sprites(b->tex, b->items + g_ref.record_mark, b->count - g_ref.record_mark);
+  }
+  g_ref.record_mark = 0;
+  bool uploaded = false;
+  for (int i = 0; i < clip_passes(); i++) {
+    if (!begin_clip_pass(i)) continue;
+    if (sw_enabled()) {
+      sw_draw_sprites(b->tex, b->items, b->count);
+    } else if (uploaded) {
+      R_MeshRedrawInstanced(&b->mesh, b->count);
+    } else {
+      R_UseProgram(b->program);
+      R_BindTexture(b->tex);
+      R_UniformMatrix4fv(b->loc.projection, g_ref.view[0]);
+      set_sprite_blend();
+      R_MeshDrawInstanced(&b->mesh, b->items, b->count);
+      uploaded = true;
+    }
+  }
+  b->count = 0;
+}
+
+// Reserve room for up to max_count quads sampling from tex.
+// Switching textures flushes the batch; call commit_sprites when done.
+sprite_instance_t *reserve_sprites(int tex, size_t max_count) {
+  sprite_batch_t *b = &g_ref.batch;
+  flush_glyphs();
+  if (b->count > 0 && b->tex != tex) {
+    flush_sprites();
+  }
+  b->tex = tex;
+  if (b->count + max_count > b->capacity) {
+    size_t capacity = MAX(b->capacity, SPRITE_BATCH_INITIAL);
+    while (capacity < b->count + max_count) capacity <<= 1;
+    sprite_instance_t *items = realloc(b->items, capacity * sizeof(sprite_instance_t));
+    if (!items) return NULL;
+    b->items = items;
+    b->capacity = capacity;
+  }
+  return b->items + b->count;
+}
+
+void commit_sprites(size_t count) {
+  g_ref.batch.count += count;
+}
+
+// Reserve room for up to max_count glyphs from the font atlas tex drawn in
+// col; *color receives the palette slot for them. A full batch is drawn
+// first, so text of any length streams through in chunks.
+glyph_instance_t *reserve_glyphs(int tex, size_t max_count, uint32_t col, uint8_t *color) {
+  glyph_batch_t *b = &g_ref.glyphs;
+  if (g_ref.batch.count > 0) {
+    flush_sprites();
+  }
+  max_count = MIN(max_count, GLYPH_BATCH_MAX);
+  if (b->count > 0 && (b->tex != tex || b->count + max_count > GLYPH_BATCH_MAX)) {
+    flush_glyphs();
+  }
+  int slot = 0;
+  while (slot < b->num_colors && b->palette[slot] != col) slot++;
+  if (slot == GLYPH_PALETTE_SIZE) {
+    flush_glyphs();
+    slot = 0;
+  }
+  if (slot == b->num_colors) {
+    b->palette[b->num_colors++] = col;
+  }
+  b->tex = tex;
+  if (b->count + max_count > b->capacity) {
+    size_t capacity = MAX(b->capacity, SPRITE_BATCH_INITIAL);
+    while (capacity < b->count + max_count) capacity <<= 1;
+    glyph_instance_t *items = realloc(b->items, capacity * sizeof(glyph_instance_t));
+    if (!items) return NULL;
+    b->items = items;
+    b->capacity = capacity;
+  }
+  *color = slot;
+  return b->items + b->count;
+}
+
+void commit_glyphs(size_t count) {
+  g_ref.glyphs.count += count;
+}
+
+// Clip a screen span to what a sprite instance holds. Spans too long for a
+// 16-bit size keep the end nearer the origin. False if nothing is left.
+static bool clip_sprite_span(int pos, int size, int16_t *out_pos, int16_t *out_size) {
+  int64_t lo = MAX(pos, INT16_MIN), hi = MIN((int64_t)pos + size, INT16_MAX);
+  if (hi <= lo) return false;
+  if (hi - lo > INT16_MAX) {
+    if (-lo > hi) lo = hi - INT16_MAX;
+    else hi = lo + INT16_MAX;
+  }
+  *out_pos = (int16_t)lo;
+  *out_size = (int16_t)(hi - lo);
+  return true;
+}
+
+// Queue a textured, colored quad; the source rect is in texels. Source rects
+// that don't fit the instance's 8-bit fields are dropped. Clipping the screen
+// rect stretches the texture, but only for quads reaching past 16-bit space.
+void push_sprite_rect(int tex, int x, int y, int w, int h,
+                      int u, int v, int uw, int vh, uint32_t col) {
+  if (u < 0 || v < 0 || uw < 0 || vh < 0 ||
+      u > UINT8_MAX || v > UINT8_MAX || uw > UINT8_MAX || vh > UINT8_MAX) {
+    return;
+  }
+  sprite_instance_t r = { .u = u, .v = v, .uw = uw, .vh = vh, .col = col };
+  if (!clip_sprite_span(x, w, &r.x, &r.w) || !clip_sprite_span(y, h, &r.y, &r.h)) {
+    return;
+  }
+  sprite_instance_t *s = reserve_sprites(tex, 1);
+  if (!s) return;
+  *s = r;
+  commit_sprites(1);
+}
+
+// Register an opaque white texel so solid fills can share a texture
+// (and therefore a batch) with text
+void set_solid_texel(int tex, int u, int v) {
+  g_ref.batch.solid_tex = tex;
+  g_ref.batch.solid_u = u;
+  g_ref.batch.solid_v = v;
+}
+
+// Queue a solid colored quad
+void push_solid_rect(int x, int y, int w, int h, uint32_t col) {
+  extern GLuint ui_white_texture;
+  sprite_batch_t *b = &g_ref.batch;
+  if (b->solid_tex) {
+    push_sprite_rect(b->solid_tex, x, y, w, h, b->solid_u, b->solid_v, 1, 1, col);
+  } else {
+    push_sprite_rect(ui_white_texture, x, y, w, h, 0, 0, 0, 0, col);
+  }
 }
 
 void push_sprite_args(int tex, int x, int y, int w, int h, float alpha) {
   // Bind sprite texture
-  glUseProgram(g_ref.program);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, tex);
-  glUniform1i(glGetUniformLocation(g_ref.program, "tex0"), 0);
-  glUniform2f(glGetUniformLocation(g_ref.program, "offset"), x, y);
-  glUniform2f(glGetUniformLocation(g_ref.program, "scale"), w, h);
-  glUniform1f(glGetUniformLocation(g_ref.program, "alpha"), alpha);
+  R_UseProgram(g_ref.program);
+  R_BindTexture(tex);
+  R_UniformMatrix4fv(g_ref.loc.projection, g_ref.view[0]);
+  R_Uniform2f(g_ref.loc.offset, x, y);
+  R_Uniform2f(g_ref.loc.scale, w, h);
+  R_Uniform1f(g_ref.loc.alpha, alpha);
 }
 
+static display_cmd_t *record_cmd(display_op_t op);
+
+// Projection is uploaded to whichever program draws next
 void set_projection(int x, int y, int w, int h) {
-  mat4 projection;
-  glm_ortho(x, w, h, y, -1, 1, projection);
-  glUseProgram(get_sprite_prog());
-  glUniformMatrix4fv(glGetUniformLocation(g_ref.program, "projection"), 1, GL_FALSE, projection[0]);
+  flush_sprites();
+  display_cmd_t *cmd = record_cmd(kDisplayProjection);
+  if (cmd) *cmd = (display_cmd_t) { .op = kDisplayProjection, .rect = { x, y, w, h } };
+  glm_ortho(x, w, h, y, -1, 1, g_ref.view);
+  if (sw_enabled()) {
+    sw_projection(x, y, w, h);
+  }
+}
+
+// Viewport in GL window coordinates (bottom-left origin)
+void set_sprite_viewport(int x, int y, int w, int h) {
+  flush_sprites();
+  display_cmd_t *cmd = record_cmd(kDisplayViewport);
+  if (cmd) *cmd = (display_cmd_t) { .op = kDisplayViewport, .rect = { x, y, w, h } };
+  R_Viewport(x, y, w, h);
+}
+
+// Enables the scissor test; same coordinates as set_sprite_viewport
+void set_sprite_scissor(int x, int y, int w, int h) {
+  flush_sprites();
+  display_cmd_t *cmd = record_cmd(kDisplayScissor);
+  if (cmd) *cmd = (display_cmd_t) { .op = kDisplayScissor, .rect = { x, y, w, h } };
+  g_ref.scissored = true;
+  g_ref.scissor[0] = x;
+  g_ref.scissor[1] = y;
+  g_ref.scissor[2] = w;
+  g_ref.scissor[3] = h;
+  // Clipped draws set the scissor per clip rect
+  if (!g_ref.clipped) {
+    R_SetCap(GL_SCISSOR_TEST, true);
+    R_Scissor(x, y, w, h);
+  }
+}
+
+// Limit drawing to this rect, e.g. the visible part of a window or a damaged
+// area; add_sprite_clip extends it. Every draw is issued once per clip rect
+// under the intersection with the scissor. Clips aren't recorded in display lists.
+void set_sprite_clip(int x, int y, int w, int h) {
+  flush_sprites();
+  g_ref.clipped = true;
+  g_ref.num_clips = 0;
+  add_sprite_clip(x, y, w, h);
+}
+
+void add_sprite_clip(int x, int y, int w, int h) {
+  flush_sprites();
+  g_ref.clipped = true;
+  if (w <= 0 || h <= 0) return;
+  if (g_ref.num_clips == g_ref.max_clips) {
+    int max_clips = MAX(8, g_ref.max_clips * 2);
+    int (*clips)[4] = realloc(g_ref.clips, max_clips * sizeof(*clips));
+    if (!clips) return;
+    g_ref.clips = clips;
+    g_ref.max_clips = max_clips;
+  }
+  int *c = g_ref.clips[g_ref.num_clips++];
+  c[0] = x;
+  c[1] = y;
+  c[2] = w;
+  c[3] = h;
+}
+
+void clear_sprite_clip(void) {
+  flush_sprites();
+  g_ref.clipped = false;
+  g_ref.num_clips = 0;
+  if (g_ref.scissored) {
+    int const *r = g_ref.scissor;
+    R_SetCap(GL_SCISSOR_TEST, true);
+    R_Scissor(r[0], r[1], r[2], r[3]);
+  } else {
+    R_SetCap(GL_SCISSOR_TEST, false);
+  }
+}
+
+// Append a command to the recording display list
+static display_cmd_t *record_cmd(display_op_t op) {
+  display_list_t *list = g_ref.recording;
+  if (!list) return NULL;
+  if (list->num_cmds == list->max_cmds) {
+    size_t max_cmds = MAX(16, list->max_cmds * 2);
+    display_cmd_t *cmds = realloc(list->cmds, max_cmds * sizeof(display_cmd_t));
+    if (!cmds) return NULL;
+    list->cmds = cmds;
+    list->max_cmds = max_cmds;
+  }
+  display_cmd_t *cmd = &list->cmds[list->num_cmds++];
+  cmd->op = op;
+  return cmd;
+}
+
+// Copy quads into the recording display list, extending the last range
+// when it samples the same texture
+static void record_sprites(int tex, sprite_instance_t const *items, size_t count) {
+  display_list_t *list = g_ref.recording;
+  if (list->num_items + count > list->max_items) {
+    size_t max_items = MAX(64, list->max_items);
+    while (max_items < list->num_items + count) max_items <<= 1;
+    sprite_instance_t *grown = realloc(list->items, max_items * sizeof(sprite_instance_t));
+    if (!grown) return;
+    list->items = grown;
+    list->max_items = max_items;
+  }
+  display_cmd_t *last = list->num_cmds ? &list->cmds[list->num_cmds - 1] : NULL;
+  if (last && last->op == kDisplaySprites && last->tex == tex &&
+      last->first + last->count == list->num_items) {
+    last->count += count;
+  } else {
+    display_cmd_t *cmd = record_cmd(kDisplaySprites);
+    if (!cmd) return;
+    *cmd = (display_cmd_t) { .op = kDisplaySprites, .tex = tex,
+                             .first = list->num_items, .count = count };
+  }
+  memcpy(list->items + list->num_items, items, count * sizeof(sprite_instance_t));
+  list->num_items += count;
+}
+
+// Start capturing sprites and state changes into list, reusing its storage.
+// Passing NULL allocates a new list. Recordings don't nest.
+display_list_t *begin_display_list(display_list_t *list) {
+  if (g_ref.recording) return NULL;
+  if (!list) {
+    list = calloc(1, sizeof(display_list_t));
+    if (!list) return NULL;
+  }
+  list->num_cmds = 0;
+  list->num_items = 0;
+  g_ref.recording = list;
+  g_ref.record_mark = g_ref.batch.count;
+  g_ref.glyph_mark = g_ref.glyphs.count;
+  return list;
+}
+
+// Stop recording. Quads still queued are copied but stay in the batch,
+// so the next window can share the same draw call.
+void end_display_list(void) {
+  sprite_batch_t *b = &g_ref.batch;
+  if (!g_ref.recording) return;
+  if (b->count > g_ref.record_mark) {
+    record_sprites(b->tex, b->items + g_ref.record_mark, b->count - g_ref.record_mark);
+  }
+  if (g_ref.glyphs.count > g_ref.glyph_mark) {
+    expand_glyphs(&g_ref.glyphs, g_ref.glyph_mark, record_sprites);
+  }
+  g_ref.recording = NULL;
+  g_ref.record_mark = 0;
+  g_ref.glyph_mark = 0;
+}
+
+bool is_recording_display_list(void) {
+  return g_ref.recording != NULL;
+}
+
+// Issue a recorded list again; quads are queued like any other
+void replay_display_list(display_list_t const *list) {
+  if (!list) return;
+  for (size_t i = 0; i < list->num_cmds; i++) {
+    display_cmd_t const *cmd = &list->cmds[i];
+    int const *r = cmd->rect;
+    switch (cmd->op) {
+      case kDisplaySprites: {
+        sprite_instance_t *s = reserve_sprites(cmd->tex, cmd->count);
+        if (!s) break;
+        memcpy(s, list->items + cmd->first, cmd->count * sizeof(sprite_instance_t));
+        commit_sprites(cmd->count);
+        break;
+      }
+      case kDisplayOutline:
+        draw_rect_ex(cmd->tex, r[0], r[1], r[2], r[3], true, cmd->alpha);
+        break;
+      case kDisplayProjection:
+        set_projection(r[0], r[1], r[2], r[3]);
+        break;
+      case kDisplayViewport:
+        set_sprite_viewport(r[0], r[1], r[2], r[3]);
+        break;
+      case kDisplayScissor:
+        set_sprite_scissor(r[0], r[1], r[2], r[3]);
+        break;
+    }
+  }
+}
+
+void free_display_list(display_list_t *list) {
+  if (!list) return;
+  if (g_ref.recording == list) {
+    g_ref.recording = NULL;
+  }
+  free(list->cmds);
+  free(list->items);
+  free(list);
 }
 
 float *get_sprite_matrix(void) {
@@ -164,21 +788,40 @@ float *get_sprite_matrix(void) {
 
 // Draw a sprite at the specified screen position
 void draw_rect_ex(int tex, int x, int y, int w, int h, int type, float alpha) {
-  push_sprite_args(tex, x, y, w, h, alpha);
-  
-  // Enable blending for transparency
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  // Disable depth testing for UI elements
-  glDisable(GL_DEPTH_TEST);
-  
-  // Use the appropriate drawing mode
-  g_ref.mesh.draw_mode = type ? GL_LINE_LOOP : GL_TRIANGLE_FAN;
+  if (!type) {
+    uint32_t a = (uint32_t)(MAX(0, MIN(1, alpha)) * 255);
+    push_sprite_rect(tex, x, y, w, h, 0, 0, 0, 0, (a << 24) | 0x00FFFFFF);
+    return;
+  }
+
+  // Outlines can't share the triangle batch
+  flush_sprites();
+  display_cmd_t *cmd = record_cmd(kDisplayOutline);
+  if (cmd) *cmd = (display_cmd_t) { .op = kDisplayOutline, .tex = tex, .rect = { x, y, w, h }, .alpha = alpha };
+  for (int i = 0; i < clip_passes(); i++) {
+    if (!begin_clip_pass(i)) continue;
+    if (sw_enabled()) {
+      sw_draw_outline(tex, x, y, w, h, alpha);
+      continue;
+    }
+    push_sprite_args(tex, x, y, w, h, alpha);
+    set_sprite_blend();
+    
+    g_ref.mesh.draw_mode = GL_LINE_LOOP;
+    R_MeshDraw(&g_ref.mesh);
+  }
+}
+
+// Draw a framebuffer texture over a screen rect. Its rows are bottom-up and
+// its colors premultiplied (see set_sprite_blend).
+void draw_surface(int tex, int x, int y, int w, int h) {
+  flush_sprites();
+  push_sprite_args(tex, x, y + h, w, -h, 1);
+  R_SetCap(GL_BLEND, true);
+  R_BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  R_SetCap(GL_DEPTH_TEST, false);
+  g_ref.mesh.draw_mode = GL_TRIANGLE_FAN;
   R_MeshDraw(&g_ref.mesh);
-  
-  // Reset state
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_BLEND);
 }
 
 // Draw a sprite at the specified screen position
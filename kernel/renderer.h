@@ -15,8 +15,11 @@ typedef struct {
   GLenum type;            // Data type (GL_FLOAT, GL_SHORT, GL_UNSIGNED_BYTE, etc.)
   GLboolean normalized;   // Whether to normalize fixed-point data
   size_t offset;          // Offset in vertex structure
+  GLuint divisor;         // 0 = per vertex, 1 = advance once per instance
 } R_VertexAttrib;
 
+#define R_MAX_INSTANCE_ATTRIBS 4  // Per-instance attributes a mesh can stream
+
 // Mesh/drawable object - encapsulates VAO, VBO, and vertex format
 typedef struct {
   GLuint vao;             // Vertex array object
@@ -25,6 +28,15 @@ typedef struct {
   size_t vertex_size;     // Size of a single vertex in bytes
   size_t vertex_count;    // Number of vertices currently in buffer
   GLenum draw_mode;       // Drawing mode (GL_TRIANGLES, GL_LINES, etc.)
+  GLint first;            // First vertex of the current data in the buffer
+  bool streaming;         // Vertex data lives in the shared stream ring
+  size_t index_count;     // Number of GLushort indices in ibo
+  // Per-instance attribute stream (see R_MeshInitInstances)
+  GLuint instance_vbo;    // Instance buffer (0 when streamed through the ring)
+  size_t instance_size;   // Size of a single instance in bytes
+  size_t instance_attrib_count;
+  R_VertexAttrib instance_attribs[R_MAX_INSTANCE_ATTRIBS];
+  bool instance_streaming;
 } R_Mesh;
 
 // Texture object - encapsulates texture state
@@ -35,23 +47,65 @@ typedef struct {
   GLenum format;          // Texture format (GL_RGBA, GL_RED, etc.)
 } R_Texture;
 
+// Offscreen render target with a single color texture
+typedef struct {
+  GLuint fbo;             // Framebuffer object
+  R_Texture color;        // Color attachment (rows are bottom-up)
+} R_Framebuffer;
+
 // Mesh management functions
 // Initialize a mesh with vertex attributes and drawing mode
 void R_MeshInit(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count, 
                 size_t vertex_size, GLenum draw_mode);
 
+// Initialize a mesh whose uploads are suballocated from the stream ring
+// instead of reallocating a VBO of its own on every draw
+void R_MeshInitStreaming(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count,
+                         size_t vertex_size, GLenum draw_mode);
+
 // Upload vertex data to mesh buffer (for static or dynamic geometry)
 void R_MeshUpload(R_Mesh* mesh, const void* data, size_t vertex_count);
 
+// Overwrite vertices [first_vertex, first_vertex + vertex_count) of the last
+// upload in place with glBufferSubData
+void R_MeshUpdate(R_Mesh* mesh, const void* data, size_t first_vertex, size_t vertex_count);
+
+// Upload an index buffer; indexed meshes draw with glDrawElements*
+void R_MeshUploadIndices(R_Mesh* mesh, const GLushort* indices, size_t index_count);
+
+// Add a per-instance attribute stream to the mesh. Attributes should have a
+// non-zero divisor. Streaming instances are suballocated from the stream ring.
+void R_MeshInitInstances(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count,
+                         size_t instance_size, bool streaming);
+
 // Draw the mesh using its current vertex data
 void R_MeshDraw(R_Mesh* mesh);
 
+// Upload instance data and draw the mesh once per instance
+void R_MeshDrawInstanced(R_Mesh* mesh, const void* instances, size_t instance_count);
+
+// Draw the last uploaded instances again without re-uploading them
+void R_MeshRedrawInstanced(R_Mesh* mesh, size_t instance_count);
+
 // Upload and draw in one call (efficient for dynamic geometry that changes every frame)
 void R_MeshDrawDynamic(R_Mesh* mesh, const void* data, size_t vertex_count);
 
 // Destroy mesh and free GPU resources
 void R_MeshDestroy(R_Mesh* mesh);
 
+// Stream ring - one large buffer written with unsynchronized maps. It is split
+// into segments that are fenced when left and at the end of every frame.
+#define R_STREAM_RING_SIZE (4 * 1024 * 1024)  // Initial ring size in bytes
+#define R_STREAM_SEGMENTS 4                   // Fenced regions in the ring
+
+// Finish the frame: fence the ring region written during it and copy the
+// persistent frame to the back buffer (or flush if there is none), or
+// present the framebuffer of the software backend
+void R_EndFrame(void);
+
+// Release the stream ring
+void R_StreamShutdown(void);
+
 // Texture management functions
 // Bind texture to current texture unit
 void R_TextureBind(R_Texture* texture);
@@ -59,6 +113,19 @@ void R_TextureBind(R_Texture* texture);
 // Unbind texture from current texture unit
 void R_TextureUnbind(void);
 
+// Framebuffer management functions
+// Create a framebuffer with a width x height RGBA color texture; false on failure
+bool R_FramebufferInit(R_Framebuffer* fb, int width, int height);
+
+// Delete a framebuffer and its texture
+void R_FramebufferDestroy(R_Framebuffer* fb);
+
+// Persistent frame drawn instead of the window and copied to its back
+// buffer by R_EndFrame. R_FrameInit returns true if the frame was (re)created.
+bool R_FrameInit(int width, int height);
+bool R_FrameEnabled(void);
+void R_FrameShutdown(void);
+
 // Low-level vertex attribute helpers
 // Enable and configure vertex attributes
 void R_SetVertexAttribs(const R_VertexAttrib* attribs, size_t count, size_t vertex_size);
@@ -69,4 +136,56 @@ void R_ClearVertexAttribs(size_t count);
 // Allocate a font texture with given dimensions and format
 GLuint R_AllocateFontTexture(R_Texture* texture, void *data);
 
+// Create an RGBA texture of texture->width x texture->height
+GLuint R_CreateTexture(R_Texture* texture, const void *data);
+
+// Delete a texture and set *id to 0
+void R_DeleteTexture(GLuint *id);
+
+// State cache - shadows GL state so redundant calls never reach the driver.
+// Code that changes this state behind the cache's back must call R_ResetState.
+#define R_MAX_UNIFORMS 16  // Uniform locations shadowed per program
+
+// Number of calls skipped because the state was already current
+typedef struct {
+  unsigned programs;
+  unsigned textures;
+  unsigned vertex_arrays;
+  unsigned buffers;
+  unsigned caps;
+  unsigned blend_funcs;
+  unsigned framebuffers;
+  unsigned scissors;
+  unsigned viewports;
+  unsigned uniforms;
+  unsigned issued;         // Calls that did reach the driver
+} R_StateStats;
+
+void R_ResetState(void);
+void R_UseProgram(GLuint program);
+void R_BindTexture(GLuint texture);
+void R_BindVertexArray(GLuint vao);
+void R_BindArrayBuffer(GLuint vbo);
+void R_SetCap(GLenum cap, bool enabled);
+void R_BlendFunc(GLenum sfactor, GLenum dfactor);
+void R_BlendFuncSeparate(GLenum sfactor, GLenum dfactor, GLenum sfactor_alpha, GLenum dfactor_alpha);
+void R_BindFramebuffer(GLuint fbo);  // 0 binds the window
+void R_Scissor(int x, int y, int w, int h);
+void R_Viewport(int x, int y, int w, int h);
+void R_ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+// Uniform setters for the current program (location -1 is ignored)
+void R_Uniform1i(GLint location, GLint value);
+void R_Uniform1f(GLint location, GLfloat value);
+void R_Uniform2f(GLint location, GLfloat x, GLfloat y);
+void R_UniformMatrix4fv(GLint location, const GLfloat *value);
+void R_Uniform4fv(GLint location, GLsizei count, const GLfloat *value);  // Uncached
+
+// Drawable size in pixels, cached until the window is resized
+void R_SetDrawableSize(int width, int height);
+void R_GetDrawableSize(int *width, int *height);
+
+R_StateStats R_GetStateStats(void);
+void R_ResetStateStats(void);
+
 #endif /* __UI_RENDERER_H__ */
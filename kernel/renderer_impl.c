@@ -1,8 +1,414 @@
 /* Renderer API Implementation - OpenGL abstraction layer */
 #include "renderer.h"
+#include "software.h"
 #include "../user/gl_compat.h"
 #include <string.h>
 
+#define STREAM_WAIT_TIMEOUT 1000000000  // Nanoseconds per glClientWaitSync
+
+// Capabilities tracked by R_SetCap
+static const GLenum cached_caps[] = {
+  GL_BLEND, GL_DEPTH_TEST, GL_SCISSOR_TEST,
+};
+#define NUM_CACHED_CAPS (sizeof(cached_caps) / sizeof(cached_caps[0]))
+
+// Shadowed value of a single uniform location
+typedef struct {
+  bool valid;
+  GLfloat value[16];
+} R_UniformShadow;
+
+// Shadow copy of the GL state last sent to the driver
+static struct {
+  bool valid;                        // False until the first R_ResetState
+  GLuint program;
+  GLuint texture;
+  GLuint vao;
+  GLuint vbo;
+  int8_t caps[NUM_CACHED_CAPS];      // -1 unknown, 0 disabled, 1 enabled
+  GLenum blend_src, blend_dst;
+  GLenum blend_src_alpha, blend_dst_alpha;
+  GLuint framebuffer;
+  int scissor[4];
+  int viewport[4];
+  int drawable[2];
+  R_UniformShadow uniforms[R_MAX_UNIFORMS];
+  R_StateStats stats;
+} r_state = {0};
+
+// Forget everything we know about the current GL state
+void R_ResetState(void) {
+  int drawable[2] = { r_state.drawable[0], r_state.drawable[1] };
+  R_StateStats stats = r_state.stats;
+  memset(&r_state, 0, sizeof(r_state));
+  memset(r_state.caps, -1, sizeof(r_state.caps));
+  r_state.blend_src = r_state.blend_dst = GL_NONE;
+  r_state.blend_src_alpha = r_state.blend_dst_alpha = GL_NONE;
+  r_state.scissor[2] = r_state.viewport[2] = -1;
+  r_state.drawable[0] = drawable[0];
+  r_state.drawable[1] = drawable[1];
+  r_state.stats = stats;
+  r_state.valid = true;
+  if (!sw_enabled()) {
+    glActiveTexture(GL_TEXTURE0);
+  }
+}
+
+void R_UseProgram(GLuint program) {
+  if (r_state.valid && r_state.program == program) {
+    r_state.stats.programs++;
+    return;
+  }
+  glUseProgram(program);
+  r_state.program = program;
+  // Uniform values are per program, so the shadows no longer apply
+  memset(r_state.uniforms, 0, sizeof(r_state.uniforms));
+  r_state.stats.issued++;
+}
+
+void R_BindTexture(GLuint texture) {
+  if (r_state.valid && r_state.texture == texture) {
+    r_state.stats.textures++;
+    return;
+  }
+  glBindTexture(GL_TEXTURE_2D, texture);
+  r_state.texture = texture;
+  r_state.stats.issued++;
+}
+
+void R_BindVertexArray(GLuint vao) {
+  if (r_state.valid && r_state.vao == vao) {
+    r_state.stats.vertex_arrays++;
+    return;
+  }
+  glBindVertexArray(vao);
+  r_state.vao = vao;
+  r_state.stats.issued++;
+}
+
+void R_BindArrayBuffer(GLuint vbo) {
+  if (r_state.valid && r_state.vbo == vbo) {
+    r_state.stats.buffers++;
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  r_state.vbo = vbo;
+  r_state.stats.issued++;
+}
+
+void R_SetCap(GLenum cap, bool enabled) {
+  for (size_t i = 0; i < NUM_CACHED_CAPS; i++) {
+    if (cached_caps[i] != cap) continue;
+    if (r_state.valid && r_state.caps[i] == enabled) {
+      r_state.stats.caps++;
+      return;
+    }
+    r_state.caps[i] = enabled;
+    break;
+  }
+  if (sw_enabled()) sw_set_cap(cap, enabled);
+  else if (enabled) glEnable(cap);
+  else glDisable(cap);
+  r_state.stats.issued++;
+}
+
+void R_BlendFunc(GLenum sfactor, GLenum dfactor) {
+  R_BlendFuncSeparate(sfactor, dfactor, sfactor, dfactor);
+}
+
+void R_BlendFuncSeparate(GLenum sfactor, GLenum dfactor, GLenum sfactor_alpha, GLenum dfactor_alpha) {
+  if (r_state.valid && r_state.blend_src == sfactor && r_state.blend_dst == dfactor &&
+      r_state.blend_src_alpha == sfactor_alpha && r_state.blend_dst_alpha == dfactor_alpha) {
+    r_state.stats.blend_funcs++;
+    return;
+  }
+  glBlendFuncSeparate(sfactor, dfactor, sfactor_alpha, dfactor_alpha);
+  r_state.blend_src = sfactor;
+  r_state.blend_dst = dfactor;
+  r_state.blend_src_alpha = sfactor_alpha;
+  r_state.blend_dst_alpha = dfactor_alpha;
+  r_state.stats.issued++;
+}
+
+void R_BindFramebuffer(GLuint fbo) {
+  if (r_state.valid && r_state.framebuffer == fbo) {
+    r_state.stats.framebuffers++;
+    return;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  r_state.framebuffer = fbo;
+  r_state.stats.issued++;
+}
+
+void R_Scissor(int x, int y, int w, int h) {
+  int rect[4] = { x, y, w, h };
+  if (r_state.valid && !memcmp(r_state.scissor, rect, sizeof(rect))) {
+    r_state.stats.scissors++;
+    return;
+  }
+  if (sw_enabled()) sw_scissor(x, y, w, h);
+  else glScissor(x, y, w, h);
+  memcpy(r_state.scissor, rect, sizeof(rect));
+  r_state.stats.issued++;
+}
+
+void R_Viewport(int x, int y, int w, int h) {
+  int rect[4] = { x, y, w, h };
+  if (r_state.valid && !memcmp(r_state.viewport, rect, sizeof(rect))) {
+    r_state.stats.viewports++;
+    return;
+  }
+  if (sw_enabled()) sw_viewport(x, y, w, h);
+  else glViewport(x, y, w, h);
+  memcpy(r_state.viewport, rect, sizeof(rect));
+  r_state.stats.issued++;
+}
+
+// Returns true if the uniform already holds the given value, otherwise
+// records it as the new value
+static bool uniform_is_current(GLint location, const GLfloat *value, size_t count) {
+  if (location < 0 || location >= R_MAX_UNIFORMS || !r_state.valid) return false;
+  R_UniformShadow *u = &r_state.uniforms[location];
+  if (u->valid && !memcmp(u->value, value, count * sizeof(GLfloat))) {
+    r_state.stats.uniforms++;
+    return true;
+  }
+  memcpy(u->value, value, count * sizeof(GLfloat));
+  u->valid = true;
+  r_state.stats.issued++;
+  return false;
+}
+
+void R_Uniform1i(GLint location, GLint value) {
+  if (location < 0 || uniform_is_current(location, (GLfloat[]){ (GLfloat)value }, 1)) return;
+  glUniform1i(location, value);
+}
+
+void R_Uniform1f(GLint location, GLfloat value) {
+  if (location < 0 || uniform_is_current(location, &value, 1)) return;
+  glUniform1f(location, value);
+}
+
+void R_Uniform2f(GLint location, GLfloat x, GLfloat y) {
+  if (location < 0 || uniform_is_current(location, (GLfloat[]){ x, y }, 2)) return;
+  glUniform2f(location, x, y);
+}
+
+void R_UniformMatrix4fv(GLint location, const GLfloat *value) {
+  if (location < 0 || uniform_is_current(location, value, 16)) return;
+  glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+// Uncached: arrays such as the glyph palette change with every batch
+void R_Uniform4fv(GLint location, GLsizei count, const GLfloat *value) {
+  if (location < 0) return;
+  glUniform4fv(location, count, value);
+}
+
+// Clear the color buffer of the bound framebuffer, ignoring the scissor
+void R_ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  R_SetCap(GL_SCISSOR_TEST, false);
+  glClearColor(r, g, b, a);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void R_SetDrawableSize(int width, int height) {
+  r_state.drawable[0] = width;
+  r_state.drawable[1] = height;
+}
+
+void R_GetDrawableSize(int *width, int *height) {
+  *width = r_state.drawable[0];
+  *height = r_state.drawable[1];
+}
+
+R_StateStats R_GetStateStats(void) {
+  return r_state.stats;
+}
+
+void R_ResetStateStats(void) {
+  memset(&r_state.stats, 0, sizeof(r_state.stats));
+}
+
+// Shared stream ring used by streaming meshes
+static struct {
+  GLuint vbo;
+  GLsizeiptr size;
+  GLintptr head;                       // Next free byte
+  int segment;                         // Segment the head is writing
+  bool mapped;                         // glMapBufferRange + sync objects available
+  GLsync fences[R_STREAM_SEGMENTS];
+} r_stream = {0};
+
+static GLsizeiptr stream_segment_size(void) {
+  return r_stream.size / R_STREAM_SEGMENTS;
+}
+
+static int stream_segment(GLintptr offset) {
+  return (int)(offset / stream_segment_size());
+}
+
+// Mark everything drawn so far from a segment
+static void stream_fence(int segment) {
+  if (!r_stream.mapped) return;
+  if (r_stream.fences[segment]) {
+    glDeleteSync(r_stream.fences[segment]);
+  }
+  r_stream.fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Block until the GPU is done reading a segment
+static void stream_wait(int segment) {
+  GLsync fence = r_stream.fences[segment];
+  if (!fence) return;
+  while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_TIMEOUT) == GL_TIMEOUT_EXPIRED);
+  glDeleteSync(fence);
+  r_stream.fences[segment] = NULL;
+}
+
+static void stream_drop_fences(void) {
+  for (int i = 0; i < R_STREAM_SEGMENTS; i++) {
+    SAFE_DELETE(r_stream.fences[i], glDeleteSync);
+  }
+}
+
+static bool stream_init(void) {
+  if (r_stream.vbo) return true;
+  
+  // Buffer mapping is core since 3.0 and sync objects since 3.2;
+  // older contexts fall back to orphaning with glBufferData
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  r_stream.mapped = major > 3 || (major == 3 && minor >= 2);
+  
+  glGenBuffers(1, &r_stream.vbo);
+  if (!r_stream.vbo) return false;
+  r_stream.size = R_STREAM_RING_SIZE;
+  r_stream.head = 0;
+  r_stream.segment = 0;
+  R_BindArrayBuffer(r_stream.vbo);
+  glBufferData(GL_ARRAY_BUFFER, r_stream.size, NULL, GL_STREAM_DRAW);
+  return true;
+}
+
+// Detach the ring storage (the driver keeps the old one alive for
+// in-flight draws) and restart at the beginning
+static void stream_orphan(GLsizeiptr min_size) {
+  if (r_stream.size < min_size) {
+    r_stream.size = min_size;
+  }
+  glBufferData(GL_ARRAY_BUFFER, r_stream.size, NULL, GL_STREAM_DRAW);
+  stream_drop_fences();
+  r_stream.head = 0;
+  r_stream.segment = 0;
+}
+
+// Copy data into the ring and return its byte offset, aligned to align
+static GLintptr stream_upload(const void* data, size_t bytes, size_t align) {
+  GLintptr offset = (r_stream.head + align - 1) / align * align;
+  
+  R_BindArrayBuffer(r_stream.vbo);
+  
+  if (!r_stream.mapped || (GLsizeiptr)bytes > stream_segment_size()) {
+    if (offset + (GLsizeiptr)bytes > r_stream.size || (GLsizeiptr)bytes > stream_segment_size()) {
+      stream_orphan(bytes);
+      offset = 0;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+    r_stream.head = offset + bytes;
+    r_stream.segment = stream_segment(offset);
+    return offset;
+  }
+  
+  if (offset + (GLsizeiptr)bytes > r_stream.size) {
+    offset = 0;
+  }
+  
+  // Wait for the GPU before reusing each segment this write enters
+  int last = stream_segment(offset + bytes - 1);
+  for (int s = stream_segment(offset); s <= last; s++) {
+    if (s == r_stream.segment) continue;
+    stream_fence(r_stream.segment);
+    stream_wait(s);
+    r_stream.segment = s;
+  }
+  
+  void *dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                               GL_MAP_INVALIDATE_RANGE_BIT);
+  if (dst) {
+    memcpy(dst, data, bytes);
+    if (glUnmapBuffer(GL_ARRAY_BUFFER)) {
+      r_stream.head = offset + bytes;
+      return offset;
+    }
+  }
+  
+  // Mapping failed; stay on the orphaning path from now on
+  r_stream.mapped = false;
+  stream_orphan(bytes);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+  r_stream.head = bytes;
+  return 0;
+}
+
+// Persistent frame; see R_FrameInit
+static R_Framebuffer r_frame = {0};
+
+// Finish a frame. With a persistent frame it is copied to the back buffer,
+// ready for SDL_GL_SwapWindow.
+void R_EndFrame(void) {
+  if (sw_enabled()) {
+    sw_present();
+    return;
+  }
+  if (r_stream.vbo) {
+    stream_fence(r_stream.segment);
+  }
+  if (r_frame.fbo) {
+    int w = r_frame.color.width, h = r_frame.color.height;
+    // The scissor limits blits too
+    R_SetCap(GL_SCISSOR_TEST, false);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, r_frame.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, r_frame.fbo);
+    r_state.framebuffer = r_frame.fbo;
+    return;
+  }
+  glFlush();
+}
+
+// Windows repaint only what changed, but a double-buffered window's back
+// buffer is undefined after a swap. Draw into a framebuffer object that
+// keeps its contents instead, (re)allocated at the given size and bound.
+// Returns true if it was created, so everything must be repainted.
+bool R_FrameInit(int width, int height) {
+  if (r_frame.fbo && r_frame.color.width == width && r_frame.color.height == height) {
+    return false;
+  }
+  R_FramebufferDestroy(&r_frame);
+  if (!R_FramebufferInit(&r_frame, width, height)) return false;
+  R_ClearColor(0, 0, 0, 1);
+  return true;
+}
+
+bool R_FrameEnabled(void) {
+  return r_frame.fbo != 0;
+}
+
+void R_FrameShutdown(void) {
+  R_FramebufferDestroy(&r_frame);
+}
+
+void R_StreamShutdown(void) {
+  stream_drop_fences();
+  if (r_state.vbo == r_stream.vbo) r_state.vbo = 0;
+  SAFE_DELETE_N(r_stream.vbo, glDeleteBuffers);
+  memset(&r_stream, 0, sizeof(r_stream));
+}
+
 // Initialize a mesh with vertex attributes and drawing mode
 void R_MeshInit(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count, 
                 size_t vertex_size, GLenum draw_mode) {
@@ -17,17 +423,38 @@ void R_MeshInit(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count
   glGenBuffers(1, &mesh->vbo);
   
   // Bind VAO to configure it
-  glBindVertexArray(mesh->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+  R_BindVertexArray(mesh->vao);
+  R_BindArrayBuffer(mesh->vbo);
   
   // Set up vertex attributes
   if (attribs && attrib_count > 0) {
     R_SetVertexAttribs(attribs, attrib_count, vertex_size);
   }
+}
+
+// Initialize a mesh that streams its vertices through the shared ring
+void R_MeshInitStreaming(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count,
+                         size_t vertex_size, GLenum draw_mode) {
+  if (!mesh) return;
+  
+  if (!stream_init()) {
+    R_MeshInit(mesh, attribs, attrib_count, vertex_size, draw_mode);
+    return;
+  }
   
-  // Unbind to avoid accidental modifications
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  memset(mesh, 0, sizeof(R_Mesh));
+  mesh->vertex_size = vertex_size;
+  mesh->draw_mode = draw_mode;
+  mesh->streaming = true;
+  
+  // The VAO sources from the ring; draws pick their region with `first`
+  glGenVertexArrays(1, &mesh->vao);
+  R_BindVertexArray(mesh->vao);
+  R_BindArrayBuffer(r_stream.vbo);
+  
+  if (attribs && attrib_count > 0) {
+    R_SetVertexAttribs(attribs, attrib_count, vertex_size);
+  }
 }
 
 // Upload vertex data to mesh buffer
@@ -36,19 +463,78 @@ void R_MeshUpload(R_Mesh* mesh, const void* data, size_t vertex_count) {
   
   mesh->vertex_count = vertex_count;
   
+  if (mesh->streaming) {
+    GLintptr offset = stream_upload(data, vertex_count * mesh->vertex_size, mesh->vertex_size);
+    mesh->first = (GLint)(offset / mesh->vertex_size);
+    return;
+  }
+  
   // Bind and upload data
-  glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+  R_BindArrayBuffer(mesh->vbo);
   glBufferData(GL_ARRAY_BUFFER, vertex_count * mesh->vertex_size, data, GL_DYNAMIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Overwrite part of the last upload in place
+void R_MeshUpdate(R_Mesh* mesh, const void* data, size_t first_vertex, size_t vertex_count) {
+  if (!mesh || !data || vertex_count == 0) return;
+  if (first_vertex + vertex_count > mesh->vertex_count) return;
+  
+  R_BindArrayBuffer(mesh->streaming ? r_stream.vbo : mesh->vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, (mesh->first + first_vertex) * mesh->vertex_size,
+                  vertex_count * mesh->vertex_size, data);
+}
+
+// Upload an index buffer (the binding is recorded in the VAO)
+void R_MeshUploadIndices(R_Mesh* mesh, const GLushort* indices, size_t index_count) {
+  if (!mesh || !indices || index_count == 0) return;
+  
+  if (!mesh->ibo) {
+    glGenBuffers(1, &mesh->ibo);
+  }
+  R_BindVertexArray(mesh->vao);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(GLushort), indices, GL_STATIC_DRAW);
+  mesh->index_count = index_count;
+}
+
+// Add a per-instance attribute stream
+void R_MeshInitInstances(R_Mesh* mesh, const R_VertexAttrib* attribs, size_t attrib_count,
+                         size_t instance_size, bool streaming) {
+  if (!mesh || !attribs || attrib_count == 0 || attrib_count > R_MAX_INSTANCE_ATTRIBS) return;
+  
+  memcpy(mesh->instance_attribs, attribs, attrib_count * sizeof(R_VertexAttrib));
+  mesh->instance_attrib_count = attrib_count;
+  mesh->instance_size = instance_size;
+  mesh->instance_streaming = streaming && stream_init();
+  
+  // Ring offsets change every draw, so streamed pointers are set in
+  // R_MeshDrawInstanced; a private buffer can be configured once
+  if (!mesh->instance_streaming) {
+    glGenBuffers(1, &mesh->instance_vbo);
+    R_BindVertexArray(mesh->vao);
+    R_BindArrayBuffer(mesh->instance_vbo);
+    R_SetVertexAttribs(attribs, attrib_count, instance_size);
+  }
+}
+
+// Point the instance attributes at a byte offset in the bound array buffer
+static void set_instance_attribs(R_Mesh* mesh, GLintptr base) {
+  for (size_t i = 0; i < mesh->instance_attrib_count; i++) {
+    const R_VertexAttrib* attr = &mesh->instance_attribs[i];
+    glEnableVertexAttribArray(attr->index);
+    glVertexAttribPointer(attr->index, attr->size, attr->type, attr->normalized,
+                          mesh->instance_size, (void*)(base + attr->offset));
+    glVertexAttribDivisor(attr->index, attr->divisor);
+  }
 }
 
 // Draw the mesh using its current vertex data
 void R_MeshDraw(R_Mesh* mesh) {
   if (!mesh || mesh->vertex_count == 0) return;
   
-  glBindVertexArray(mesh->vao);
-  glDrawArrays(mesh->draw_mode, 0, mesh->vertex_count);
-  glBindVertexArray(0);
+  // The VAO stays bound; the state cache skips rebinding it next draw
+  R_BindVertexArray(mesh->vao);
+  glDrawArrays(mesh->draw_mode, mesh->first, mesh->vertex_count);
 }
 
 // Upload and draw in one call (efficient for dynamic geometry)
@@ -57,28 +543,68 @@ void R_MeshDrawDynamic(R_Mesh* mesh, const void* data, size_t vertex_count) {
   
   mesh->vertex_count = vertex_count;
   
+  if (mesh->streaming) {
+    R_MeshUpload(mesh, data, vertex_count);
+    R_BindVertexArray(mesh->vao);
+    glDrawArrays(mesh->draw_mode, mesh->first, vertex_count);
+    return;
+  }
+  
   // Bind VAO
-  glBindVertexArray(mesh->vao);
+  R_BindVertexArray(mesh->vao);
   
   // Upload vertex data
-  glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+  R_BindArrayBuffer(mesh->vbo);
   glBufferData(GL_ARRAY_BUFFER, vertex_count * mesh->vertex_size, data, GL_DYNAMIC_DRAW);
   
   // Draw
   glDrawArrays(mesh->draw_mode, 0, vertex_count);
+}
+
+// Upload instance data and draw the mesh once per instance
+void R_MeshDrawInstanced(R_Mesh* mesh, const void* instances, size_t instance_count) {
+  if (!mesh || !instances || instance_count == 0 || !mesh->instance_attrib_count) return;
   
-  // Unbind to avoid accidental modifications
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  size_t bytes = instance_count * mesh->instance_size;
+  if (mesh->instance_streaming) {
+    GLintptr offset = stream_upload(instances, bytes, sizeof(GLint));
+    R_BindVertexArray(mesh->vao);
+    set_instance_attribs(mesh, offset);
+  } else {
+    R_BindVertexArray(mesh->vao);
+    R_BindArrayBuffer(mesh->instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, instances, GL_STREAM_DRAW);
+  }
+  R_MeshRedrawInstanced(mesh, instance_count);
+}
+
+// Draw the instances uploaded by the last R_MeshDrawInstanced again, e.g.
+// under another scissor rect
+void R_MeshRedrawInstanced(R_Mesh* mesh, size_t instance_count) {
+  if (!mesh || instance_count == 0) return;
+  
+  R_BindVertexArray(mesh->vao);
+  if (mesh->index_count) {
+    glDrawElementsInstanced(mesh->draw_mode, mesh->index_count, GL_UNSIGNED_SHORT,
+                            NULL, instance_count);
+  } else {
+    glDrawArraysInstanced(mesh->draw_mode, mesh->first, mesh->vertex_count, instance_count);
+  }
 }
 
 // Destroy mesh and free GPU resources
 void R_MeshDestroy(R_Mesh* mesh) {
   if (!mesh) return;
   
+  // Deleted names may be reused, so drop them from the cache
+  if (r_state.vao == mesh->vao) r_state.vao = 0;
+  if (r_state.vbo == mesh->vbo) r_state.vbo = 0;
+  
   SAFE_DELETE_N(mesh->vao, glDeleteVertexArrays);
   SAFE_DELETE_N(mesh->vbo, glDeleteBuffers);
   SAFE_DELETE_N(mesh->ibo, glDeleteBuffers);
+  if (r_state.vbo == mesh->instance_vbo) r_state.vbo = 0;
+  SAFE_DELETE_N(mesh->instance_vbo, glDeleteBuffers);
   
   memset(mesh, 0, sizeof(R_Mesh));
 }
@@ -86,12 +612,12 @@ void R_MeshDestroy(R_Mesh* mesh) {
 // Bind texture to current texture unit
 void R_TextureBind(R_Texture* texture) {
   if (!texture || texture->id == 0) return;
-  glBindTexture(GL_TEXTURE_2D, texture->id);
+  R_BindTexture(texture->id);
 }
 
 // Unbind texture from current texture unit
 void R_TextureUnbind(void) {
-  glBindTexture(GL_TEXTURE_2D, 0);
+  R_BindTexture(0);
 }
 
 // Enable and configure vertex attributes
@@ -103,6 +629,9 @@ void R_SetVertexAttribs(const R_VertexAttrib* attribs, size_t count, size_t vert
     glEnableVertexAttribArray(attr->index);
     glVertexAttribPointer(attr->index, attr->size, attr->type, attr->normalized,
                          vertex_size, (void*)attr->offset);
+    if (attr->divisor) {
+      glVertexAttribDivisor(attr->index, attr->divisor);
+    }
   }
 }
 
@@ -113,10 +642,38 @@ void R_ClearVertexAttribs(size_t count) {
   }
 }
 
+// Create an RGBA texture with nearest filtering
+GLuint R_CreateTexture(R_Texture* tex, const void *data) {
+  if (sw_enabled()) {
+    return tex->id = sw_create_texture(tex->width, tex->height, GL_RGBA, data);
+  }
+  glGenTextures(1, &tex->id);
+  R_BindTexture(tex->id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  return tex->id;
+}
+
+// Delete a texture and clear the handle
+void R_DeleteTexture(GLuint *id) {
+  if (!*id) return;
+  if (r_state.texture == *id) r_state.texture = 0;
+  if (sw_enabled()) {
+    sw_delete_texture(*id);
+    *id = 0;
+    return;
+  }
+  SAFE_DELETE_N(*id, glDeleteTextures);
+}
+
 // Allocate a font texture with given dimensions and format
 GLuint R_AllocateFontTexture(R_Texture* tex, void *data) {
+  if (sw_enabled()) {
+    return tex->id = sw_create_texture(tex->width, tex->height, tex->format, data);
+  }
   glGenTextures(1, &tex->id);
-  glBindTexture(GL_TEXTURE_2D, tex->id);
+  R_BindTexture(tex->id);
   
   // Set texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -133,3 +690,33 @@ GLuint R_AllocateFontTexture(R_Texture* tex, void *data) {
 
   return tex->id;
 }
+
+// Create a framebuffer rendering into a width x height RGBA texture
+bool R_FramebufferInit(R_Framebuffer* fb, int width, int height) {
+  memset(fb, 0, sizeof(*fb));
+  if (width <= 0 || height <= 0) return false;
+  fb->color.width = width;
+  fb->color.height = height;
+  fb->color.format = GL_RGBA;
+  R_CreateTexture(&fb->color, NULL);
+  glGenFramebuffers(1, &fb->fbo);
+  R_BindFramebuffer(fb->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fb->color.id, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    R_FramebufferDestroy(fb);
+    return false;
+  }
+  return true;
+}
+
+// Delete the framebuffer and its texture; unbinds it if bound
+void R_FramebufferDestroy(R_Framebuffer* fb) {
+  if (fb->fbo) {
+    if (r_state.framebuffer == fb->fbo) {
+      R_BindFramebuffer(0);
+    }
+    SAFE_DELETE_N(fb->fbo, glDeleteFramebuffers);
+  }
+  R_DeleteTexture(&fb->color.id);
+  memset(fb, 0, sizeof(*fb));
+}
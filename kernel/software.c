@@ -0,0 +1,392 @@
+// Software rasterizer backend
+// Mirrors the sprite shader and the GL state the UI uses: nearest sampling,
+// alpha discard below 0.1, SRC_ALPHA/ONE_MINUS_SRC_ALPHA blending, and
+// viewport and scissor clipping
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../user/messages.h"
+#include "software.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SW_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#define SW_ALPHA_DISCARD 25  // The shader discards alpha < 0.1, i.e. <= 25/255
+
+typedef struct {
+  int x, y, w, h;
+} sw_rect_t;
+
+typedef struct {
+  int width, height;
+  uint32_t *pixels;          // NULL for free slots
+} sw_texture_t;
+
+// Span kernel: writes src over n pixels
+typedef void (*sw_span_fn)(uint32_t *dst, int n, uint32_t src);
+
+static struct {
+  bool enabled;
+  int width, height;
+  uint32_t *color;
+  sw_rect_t viewport;        // Top-down framebuffer coordinates
+  sw_rect_t scissor;
+  float proj[4];             // Left, top, right, bottom
+  bool scissor_test;
+  sw_texture_t *textures;    // Texture id is index + 1
+  size_t num_textures;
+  sw_span_fn fill_span;      // Opaque source
+  sw_span_fn blend_span;     // Translucent source
+  SDL_Renderer *renderer;
+  SDL_Texture *target;
+} sw = {0};
+
+// Sampling a missing texture gives opaque black, like an incomplete GL texture
+static uint32_t missing_texel = 0xFF000000;
+static const sw_texture_t missing_texture = { 1, 1, &missing_texel };
+
+static inline uint32_t mul_div255(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+// Texture color times vertex color, per channel
+static inline uint32_t modulate(uint32_t texel, uint32_t col) {
+  if (texel == 0xFFFFFFFF) return col;
+  if (col == 0xFFFFFFFF) return texel;
+  uint32_t out = 0;
+  for (int c = 0; c < 32; c += 8) {
+    out |= mul_div255((texel >> c) & 0xFF, (col >> c) & 0xFF) << c;
+  }
+  return out;
+}
+
+static inline uint32_t blend_pixel(uint32_t src, uint32_t dst) {
+  uint32_t a = src >> 24, ia = 255 - a, out = 0;
+  for (int c = 0; c < 32; c += 8) {
+    uint32_t t = ((src >> c) & 0xFF) * a + ((dst >> c) & 0xFF) * ia + 128;
+    out |= ((t + (t >> 8)) >> 8) << c;
+  }
+  return out;
+}
+
+static void fill_span_scalar(uint32_t *dst, int n, uint32_t src) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = src;
+  }
+}
+
+static void blend_span_scalar(uint32_t *dst, int n, uint32_t src) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = blend_pixel(src, dst[i]);
+  }
+}
+
+#ifdef SW_SIMD_X86
+// (dst * (255 - a) + src * a) / 255 for 4 pixels; sterm is src * a + 128
+static inline __m128i blend4(__m128i d, __m128i sterm, __m128i ia) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia), sterm);
+  __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia), sterm);
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+  return _mm_packus_epi16(lo, hi);
+}
+
+static void fill_span_sse2(uint32_t *dst, int n, uint32_t src) {
+  __m128i s = _mm_set1_epi32((int)src);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_si128((__m128i *)(dst + i), s);
+  }
+  fill_span_scalar(dst + i, n - i, src);
+}
+
+static void blend_span_sse2(uint32_t *dst, int n, uint32_t src) {
+  uint32_t a = src >> 24;
+  __m128i s16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)src), _mm_setzero_si128());
+  __m128i sterm = _mm_add_epi16(_mm_mullo_epi16(s16, _mm_set1_epi16((short)a)), _mm_set1_epi16(128));
+  __m128i ia = _mm_set1_epi16((short)(255 - a));
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i *p = (__m128i *)(dst + i);
+    _mm_storeu_si128(p, blend4(_mm_loadu_si128(p), sterm, ia));
+  }
+  blend_span_scalar(dst + i, n - i, src);
+}
+
+__attribute__((target("avx2")))
+static void fill_span_avx2(uint32_t *dst, int n, uint32_t src) {
+  __m256i s = _mm256_set1_epi32((int)src);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_si256((__m256i *)(dst + i), s);
+  }
+  fill_span_sse2(dst + i, n - i, src);
+}
+
+__attribute__((target("avx2")))
+static void blend_span_avx2(uint32_t *dst, int n, uint32_t src) {
+  uint32_t a = src >> 24;
+  __m256i zero = _mm256_setzero_si256();
+  __m256i s16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)src), zero);
+  __m256i sterm = _mm256_add_epi16(_mm256_mullo_epi16(s16, _mm256_set1_epi16((short)a)), _mm256_set1_epi16(128));
+  __m256i ia = _mm256_set1_epi16((short)(255 - a));
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i *p = (__m256i *)(dst + i);
+    __m256i d = _mm256_loadu_si256(p);
+    // Unpack and pack both work per 128-bit lane, so pixel order is kept
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia), sterm);
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia), sterm);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+    _mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+  }
+  blend_span_sse2(dst + i, n - i, src);
+}
+#endif
+
+static void pick_span_kernels(void) {
+  sw.fill_span = fill_span_scalar;
+  sw.blend_span = blend_span_scalar;
+#ifdef SW_SIMD_X86
+  sw.fill_span = fill_span_sse2;
+  sw.blend_span = blend_span_sse2;
+  if (SDL_HasAVX2()) {
+    sw.fill_span = fill_span_avx2;
+    sw.blend_span = blend_span_avx2;
+  }
+#endif
+}
+
+static sw_rect_t intersect(sw_rect_t a, sw_rect_t b) {
+  int x0 = MAX(a.x, b.x), y0 = MAX(a.y, b.y);
+  int x1 = MIN(a.x + a.w, b.x + b.w), y1 = MIN(a.y + a.h, b.y + b.h);
+  return (sw_rect_t) { x0, y0, MAX(0, x1 - x0), MAX(0, y1 - y0) };
+}
+
+// GL rects have a bottom-left origin; the framebuffer is stored top-down
+static sw_rect_t from_gl(int x, int y, int w, int h) {
+  return (sw_rect_t) { x, sw.height - y - h, w, h };
+}
+
+// First pixel whose center is at or past v
+static inline int pixel_edge(float v) {
+  return (int)ceilf(v - 0.5f);
+}
+
+static const sw_texture_t *get_texture(GLuint id) {
+  if (id == 0 || id > sw.num_textures || !sw.textures[id - 1].pixels) {
+    return &missing_texture;
+  }
+  return &sw.textures[id - 1];
+}
+
+static inline uint32_t fetch(const sw_texture_t *tex, int x, int y) {
+  x = MAX(0, MIN(tex->width - 1, x));
+  y = MAX(0, MIN(tex->height - 1, y));
+  return tex->pixels[y * tex->width + x];
+}
+
+// Fill a clipped rect with one color
+static void draw_solid(sw_rect_t r, uint32_t src) {
+  if ((src >> 24) <= SW_ALPHA_DISCARD) return;
+  sw_span_fn span = (src >> 24) == 255 ? sw.fill_span : sw.blend_span;
+  for (int y = r.y; y < r.y + r.h; y++) {
+    span(sw.color + y * sw.width + r.x, r.w, src);
+  }
+}
+
+// Draw one sprite instance through the current projection and clip state
+static void draw_sprite(const sw_texture_t *tex, const sprite_instance_t *s) {
+  float pw = sw.proj[2] - sw.proj[0], ph = sw.proj[3] - sw.proj[1];
+  if (pw == 0 || ph == 0) return;
+  float sx = sw.viewport.w / pw, sy = sw.viewport.h / ph;
+  float fx0 = sw.viewport.x + (s->x - sw.proj[0]) * sx;
+  float fy0 = sw.viewport.y + (s->y - sw.proj[1]) * sy;
+  float fx1 = fx0 + s->w * sx;
+  float fy1 = fy0 + s->h * sy;
+
+  int x0 = pixel_edge(fx0), y0 = pixel_edge(fy0);
+  sw_rect_t r = { x0, y0, pixel_edge(fx1) - x0, pixel_edge(fy1) - y0 };
+  r = intersect(r, (sw_rect_t) { 0, 0, sw.width, sw.height });
+  r = intersect(r, sw.viewport);
+  if (sw.scissor_test) r = intersect(r, sw.scissor);
+  if (r.w <= 0 || r.h <= 0) return;
+
+  // Source rect in texels; an empty one covers the whole texture
+  int u = s->u, v = s->v, uw = s->uw, vh = s->vh;
+  if (!uw && !vh) {
+    u = v = 0;
+    uw = tex->width;
+    vh = tex->height;
+  }
+  if ((uw == 1 && vh == 1) || (tex->width == 1 && tex->height == 1)) {
+    draw_solid(r, modulate(fetch(tex, u, v), s->col));
+    return;
+  }
+
+  // Step through the source rect in 16.16 fixed point, sampling at pixel centers
+  int64_t du = (int64_t)(uw / (fx1 - fx0) * 65536.0f);
+  int64_t dv = (int64_t)(vh / (fy1 - fy0) * 65536.0f);
+  int64_t u0 = (int64_t)((u + (r.x + 0.5f - fx0) * uw / (fx1 - fx0)) * 65536.0f);
+  int64_t tv = (int64_t)((v + (r.y + 0.5f - fy0) * vh / (fy1 - fy0)) * 65536.0f);
+
+  for (int y = r.y; y < r.y + r.h; y++, tv += dv) {
+    uint32_t *dst = sw.color + y * sw.width + r.x;
+    int64_t tu = u0;
+    for (int i = 0; i < r.w; i++, tu += du) {
+      uint32_t src = modulate(fetch(tex, (int)(tu >> 16), (int)(tv >> 16)), s->col);
+      if ((src >> 24) <= SW_ALPHA_DISCARD) continue;
+      dst[i] = (src >> 24) == 255 ? src : blend_pixel(src, dst[i]);
+    }
+  }
+}
+
+bool sw_init(SDL_Window *win, int width, int height) {
+  sw_shutdown();
+
+  sw.color = malloc((size_t)width * height * sizeof(uint32_t));
+  if (!sw.color) return false;
+  for (int i = 0; i < width * height; i++) {
+    sw.color[i] = 0xFF000000;
+  }
+
+  sw.width = width;
+  sw.height = height;
+  sw.viewport = sw.scissor = (sw_rect_t) { 0, 0, width, height };
+  sw.proj[2] = width;
+  sw.proj[3] = height;
+  pick_span_kernels();
+
+  if (win) {
+    sw.renderer = SDL_CreateRenderer(win, -1, 0);
+    if (!sw.renderer) {
+      sw.renderer = SDL_CreateRenderer(win, -1, SDL_RENDERER_SOFTWARE);
+    }
+    if (sw.renderer) {
+      sw.target = SDL_CreateTexture(sw.renderer, SDL_PIXELFORMAT_RGBA32,
+                                    SDL_TEXTUREACCESS_STREAMING, width, height);
+    }
+    if (!sw.target) {
+      printf("Software renderer can't present: %s\n", SDL_GetError());
+    }
+  }
+
+  sw.enabled = true;
+  return true;
+}
+
+void sw_shutdown(void) {
+  for (size_t i = 0; i < sw.num_textures; i++) {
+    free(sw.textures[i].pixels);
+  }
+  free(sw.textures);
+  free(sw.color);
+  if (sw.target) SDL_DestroyTexture(sw.target);
+  if (sw.renderer) SDL_DestroyRenderer(sw.renderer);
+  memset(&sw, 0, sizeof(sw));
+}
+
+bool sw_enabled(void) {
+  return sw.enabled;
+}
+
+GLuint sw_create_texture(int width, int height, GLenum format, const void *data) {
+  if (width <= 0 || height <= 0) return 0;
+
+  uint32_t *pixels = malloc((size_t)width * height * sizeof(uint32_t));
+  if (!pixels) return 0;
+  for (int i = 0; i < width * height; i++) {
+    if (!data) {
+      pixels[i] = 0;
+    } else if (format == GL_RED) {
+      pixels[i] = ((uint32_t)((const uint8_t *)data)[i] << 24) | 0x00FFFFFF;
+    } else {
+      memcpy(&pixels[i], (const uint8_t *)data + i * 4, sizeof(uint32_t));
+    }
+  }
+
+  // Reuse a free slot before growing the table
+  size_t slot = 0;
+  while (slot < sw.num_textures && sw.textures[slot].pixels) slot++;
+  if (slot == sw.num_textures) {
+    sw_texture_t *textures = realloc(sw.textures, (sw.num_textures + 1) * sizeof(sw_texture_t));
+    if (!textures) {
+      free(pixels);
+      return 0;
+    }
+    sw.textures = textures;
+    sw.num_textures++;
+  }
+  sw.textures[slot] = (sw_texture_t) { width, height, pixels };
+  return (GLuint)(slot + 1);
+}
+
+void sw_delete_texture(GLuint id) {
+  if (id == 0 || id > sw.num_textures) return;
+  SAFE_DELETE(sw.textures[id - 1].pixels, free);
+}
+
+void sw_viewport(int x, int y, int w, int h) {
+  sw.viewport = from_gl(x, y, w, h);
+}
+
+void sw_scissor(int x, int y, int w, int h) {
+  sw.scissor = from_gl(x, y, w, h);
+}
+
+void sw_set_cap(GLenum cap, bool enabled) {
+  switch (cap) {
+    case GL_SCISSOR_TEST: sw.scissor_test = enabled; break;
+    default: break;  // Blending is always on for sprites, depth is unused
+  }
+}
+
+void sw_projection(int left, int top, int right, int bottom) {
+  sw.proj[0] = left;
+  sw.proj[1] = top;
+  sw.proj[2] = right;
+  sw.proj[3] = bottom;
+}
+
+void sw_draw_sprites(GLuint tex, const sprite_instance_t *items, size_t count) {
+  if (!sw.enabled) return;
+  const sw_texture_t *texture = get_texture(tex);
+  for (size_t i = 0; i < count; i++) {
+    draw_sprite(texture, &items[i]);
+  }
+}
+
+void sw_draw_outline(GLuint tex, int x, int y, int w, int h, float alpha) {
+  if (!sw.enabled || w <= 0 || h <= 0) return;
+  uint32_t a = (uint32_t)(MAX(0, MIN(1, alpha)) * 255);
+  uint32_t col = (a << 24) | 0x00FFFFFF;
+  sprite_instance_t edges[] = {
+    { x, y, w, 1, 0, 0, 0, 0, col },
+    { x, y + h - 1, w, 1, 0, 0, 0, 0, col },
+    { x, y + 1, 1, h - 2, 0, 0, 0, 0, col },
+    { x + w - 1, y + 1, 1, h - 2, 0, 0, 0, 0, col },
+  };
+  sw_draw_sprites(tex, edges, sizeof(edges) / sizeof(edges[0]));
+}
+
+void sw_present(void) {
+  if (!sw.target) return;
+  SDL_UpdateTexture(sw.target, NULL, sw.color, sw.width * sizeof(uint32_t));
+  SDL_RenderCopy(sw.renderer, sw.target, NULL, NULL);
+  SDL_RenderPresent(sw.renderer);
+}
+
+uint32_t *sw_framebuffer(int *width, int *height) {
+  if (width) *width = sw.width;
+  if (height) *height = sw.height;
+  return sw.color;
+}
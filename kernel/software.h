@@ -0,0 +1,38 @@
+/* Software rasterizer - renders the sprite batch into an RGBA8 framebuffer
+ * on the CPU for machines without a usable GPU (see UI_INIT_SOFTWARE)
+ */
+#ifndef __UI_SOFTWARE_H__
+#define __UI_SOFTWARE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "kernel.h"
+
+// Create a width x height framebuffer. With a window, frames are presented
+// through an SDL_Renderer; without one the framebuffer is only kept in memory.
+bool sw_init(SDL_Window *win, int width, int height);
+void sw_shutdown(void);
+bool sw_enabled(void);
+
+// Textures - GL_RGBA is copied as is, GL_RED becomes white with alpha = red,
+// like the swizzled font atlas. Ids are never 0.
+GLuint sw_create_texture(int width, int height, GLenum format, const void *data);
+void sw_delete_texture(GLuint id);
+
+// GL-style state; rects use a bottom-left origin like glViewport/glScissor
+void sw_viewport(int x, int y, int w, int h);
+void sw_scissor(int x, int y, int w, int h);
+void sw_set_cap(GLenum cap, bool enabled);
+void sw_projection(int left, int top, int right, int bottom);
+
+// Draw queued sprites, or a one pixel rectangle outline
+void sw_draw_sprites(GLuint tex, const sprite_instance_t *items, size_t count);
+void sw_draw_outline(GLuint tex, int x, int y, int w, int h, float alpha);
+
+// Show the framebuffer in the window
+void sw_present(void);
+
+// Framebuffer access (rows top to bottom, 0xAABBGGRR pixels)
+uint32_t *sw_framebuffer(int *width, int *height);
+
+#endif /* __UI_SOFTWARE_H__ */
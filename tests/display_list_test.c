@@ -0,0 +1,157 @@
+// Display List Tests
+// Records window paints on the software rasterizer and checks that clean
+// windows replay them without calling their window procedure
+
+#include "test_framework.h"
+#include "test_env.h"
+#include "../ui.h"
+#include "../kernel/software.h"
+
+#define FB_WIDTH 32
+#define FB_HEIGHT 16
+
+#define RED    0xFF0000FF
+#define GREEN  0xFF00FF00
+#define BLACK  0xFF000000
+
+static int paint_count = 0;
+static uint32_t paint_color = RED;
+static int white_tex = 0;
+
+static result_t paint_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)wparam;
+    (void)lparam;
+    if (msg == kWindowMessagePaint) {
+        paint_count++;
+        fill_rect(paint_color, win->frame.x, win->frame.y, win->frame.w, win->frame.h);
+        return true;
+    }
+    return false;
+}
+
+void test_setup(void) {
+    TEST("Software framebuffer for replay checks");
+    ASSERT_TRUE(sw_init(NULL, FB_WIDTH, FB_HEIGHT));
+    uint32_t white = 0xFFFFFFFF;
+    white_tex = sw_create_texture(1, 1, GL_RGBA, &white);
+    set_solid_texel(white_tex, 0, 0);
+    sw_viewport(0, 0, FB_WIDTH, FB_HEIGHT);
+    PASS();
+}
+
+void test_record_and_replay(void) {
+    TEST("Replay redraws recorded quads and state");
+    test_env_clear(BLACK);
+    display_list_t *list = begin_display_list(NULL);
+    ASSERT_NOT_NULL(list);
+    ASSERT_TRUE(is_recording_display_list());
+    set_projection(0, 0, FB_WIDTH, FB_HEIGHT);
+    push_solid_rect(1, 1, 4, 4, RED);
+    set_projection(-10, 0, FB_WIDTH - 10, FB_HEIGHT);  // Forces a flush mid-recording
+    push_solid_rect(1, 1, 4, 4, GREEN);
+    end_display_list();
+    ASSERT_FALSE(is_recording_display_list());
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(1, 1), RED);
+    ASSERT_EQUAL(test_env_pixel(11, 1), GREEN);
+
+    test_env_clear(BLACK);
+    ASSERT_EQUAL(test_env_pixel(1, 1), BLACK);
+    replay_display_list(list);
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(1, 1), RED);
+    ASSERT_EQUAL(test_env_pixel(11, 1), GREEN);
+    free_display_list(list);
+    PASS();
+}
+
+void test_pending_quads_excluded(void) {
+    TEST("Quads queued before recording are not captured");
+    test_env_clear(BLACK);
+    push_solid_rect(20, 1, 2, 2, GREEN);
+    display_list_t *list = begin_display_list(NULL);
+    push_solid_rect(1, 1, 2, 2, RED);
+    end_display_list();
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(20, 1), GREEN);
+
+    test_env_clear(BLACK);
+    replay_display_list(list);
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(1, 1), RED);
+    ASSERT_EQUAL(test_env_pixel(20, 1), BLACK);
+
+    // Re-recording reuses the list and drops the old contents
+    ASSERT_EQUAL(begin_display_list(list), list);
+    ASSERT_NULL(begin_display_list(NULL));
+    end_display_list();
+    test_env_clear(BLACK);
+    replay_display_list(list);
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(1, 1), BLACK);
+    free_display_list(list);
+    PASS();
+}
+
+void test_sprite_rect_limits(void) {
+    TEST("Out-of-range sprite rects are clipped or dropped");
+    test_env_clear(BLACK);
+    // Wider than int16_t: clipped rather than wrapped
+    push_solid_rect(-40000, 1, 40004, 2, RED);
+    // A source rect past the 8-bit fields is dropped, not wrapped to u = 0
+    push_sprite_rect(white_tex, 8, 1, 2, 2, 256, 0, 1, 1, GREEN);
+    push_sprite_rect(white_tex, 12, 1, 2, 2, 0, 0, 256, 1, GREEN);
+    flush_sprites();
+    ASSERT_EQUAL(test_env_pixel(0, 1), RED);
+    ASSERT_EQUAL(test_env_pixel(3, 2), RED);
+    ASSERT_EQUAL(test_env_pixel(4, 1), BLACK);
+    ASSERT_EQUAL(test_env_pixel(8, 1), BLACK);
+    ASSERT_EQUAL(test_env_pixel(12, 1), BLACK);
+    PASS();
+}
+
+void test_window_replay(void) {
+    TEST("Clean windows replay; invalidated windows repaint");
+    running = true;
+    window_t *win = create_window("Panel", WINDOW_NOTITLE, MAKERECT(2, 2, 8, 8), NULL, paint_proc, NULL);
+    send_message(win, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(paint_count, 1);
+    send_message(win, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(paint_count, 1);
+
+    invalidate_window(win);
+    ASSERT_TRUE(win->dirty);
+    send_message(win, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(paint_count, 2);
+    ASSERT_FALSE(win->dirty);
+
+    // Invalidating a child makes the parent run its procedure again
+    window_t *child = create_window("Child", 0, MAKERECT(1, 1, 2, 2), win, paint_proc, NULL);
+    ASSERT_TRUE(win->dirty);
+    send_message(win, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(paint_count, 3);
+    invalidate_window(child);
+    send_message(win, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(paint_count, 4);
+
+    destroy_window(win);
+    running = false;
+    PASS();
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    TEST_START("Display Lists");
+
+    test_setup();
+    test_record_and_replay();
+    test_pending_quads_excluded();
+    test_sprite_rect_limits();
+    test_window_replay();
+
+    sw_shutdown();
+
+    TEST_END();
+}
@@ -0,0 +1,166 @@
+// Hit Testing Tests
+// Checks that find_window picks the topmost window and child under the
+// mouse, that moving, resizing, hiding, raising and destroying windows keep
+// the answer up to date, and that z-order bands hold
+
+#include "test_framework.h"
+#include "../ui.h"
+
+extern window_t *windows;
+
+static result_t plain_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)win;
+    (void)msg;
+    (void)wparam;
+    (void)lparam;
+    return false;
+}
+
+void test_top_level(void) {
+    TEST("Topmost visible window under the point wins");
+    window_t *back = create_window("Back", 0, MAKERECT(10, 20, 40, 40), NULL, plain_proc, NULL);
+    window_t *front = create_window("Front", WINDOW_NOTITLE, MAKERECT(30, 30, 40, 40), NULL, plain_proc, NULL);
+    ASSERT_NULL(find_window(15, 25));
+    show_window(back, true);
+    show_window(front, true);
+
+    ASSERT_EQUAL(find_window(15, 25), back);
+    ASSERT_EQUAL(find_window(35, 35), front);
+    ASSERT_NULL(find_window(5, 5));
+    // The title bar above the client area belongs to the window
+    ASSERT_EQUAL(find_window(15, 20 - TITLEBAR_HEIGHT), back);
+    ASSERT_NULL(find_window(15, 19 - TITLEBAR_HEIGHT));
+
+    // The same point again, then after raising the other window
+    ASSERT_EQUAL(find_window(35, 35), front);
+    move_to_top(back);
+    ASSERT_EQUAL(find_window(35, 35), back);
+    ASSERT_EQUAL(find_window(60, 60), front);
+
+    move_window(back, 200, 200);
+    ASSERT_EQUAL(find_window(35, 35), front);
+    ASSERT_EQUAL(find_window(205, 205), back);
+    resize_window(back, 100, 100);
+    ASSERT_EQUAL(find_window(290, 290), back);
+
+    show_window(front, false);
+    ASSERT_NULL(find_window(35, 35));
+    destroy_window(back);
+    ASSERT_NULL(find_window(205, 205));
+    destroy_window(front);
+    PASS();
+}
+
+void test_children(void) {
+    TEST("Hundreds of children hit test through the grid");
+    window_t *win = create_window("Grid", WINDOW_NOTITLE, MAKERECT(0, 0, 400, 400), NULL, plain_proc, NULL);
+    show_window(win, true);
+    window_t *items[20][20];
+    for (int y = 0; y < 20; y++) {
+        for (int x = 0; x < 20; x++) {
+            items[y][x] = create_window("", 0, MAKERECT(x * 20, y * 20, 18, 18), win, plain_proc, NULL);
+        }
+    }
+    ASSERT_EQUAL(find_window(5, 5), items[0][0]);
+    ASSERT_EQUAL(find_window(385, 245), items[12][19]);
+    ASSERT_EQUAL(find_window(385, 246), items[12][19]);
+    // Gaps between children hit the window itself
+    ASSERT_EQUAL(find_window(19, 5), win);
+
+    // Later children are on top; labels and other notabstop children don't take hits
+    window_t *over = create_window("", 0, MAKERECT(15, 15, 10, 10), win, plain_proc, NULL);
+    ASSERT_EQUAL(find_window(5, 5), items[0][0]);
+    ASSERT_EQUAL(find_window(16, 16), over);
+    over->notabstop = true;
+    ASSERT_EQUAL(find_window(16, 16), items[0][0]);
+    ASSERT_EQUAL(find_window(21, 21), items[1][1]);
+
+    move_window(items[0][0], 100, 500);
+    resize_window(win, 400, 600);
+    ASSERT_EQUAL(find_window(5, 5), win);
+    ASSERT_EQUAL(find_window(105, 505), items[0][0]);
+
+    // Disabled windows keep clicks to themselves
+    enable_window(win, false);
+    ASSERT_EQUAL(find_window(105, 505), win);
+    destroy_window(win);
+    ASSERT_NULL(find_window(105, 505));
+    PASS();
+}
+
+// Top-level windows back to front as a string of title initials
+static char const *z_order(void) {
+    static char order[16];
+    int n = 0;
+    for (window_t *w = windows; w && n < 15; w = w->next) {
+        order[n++] = w->cold->title[0];
+    }
+    order[n] = '\0';
+    return order;
+}
+
+void test_layers(void) {
+    TEST("Raising keeps windows within their band");
+    window_t *normal = create_window("N", 0, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    window_t *top = create_window("T", WINDOW_ALWAYSONTOP, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    window_t *back = create_window("B", WINDOW_ALWAYSINBACK, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    window_t *popup = create_window("P", WINDOW_POPUP, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    window_t *other = create_window("O", 0, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    ASSERT_STR_EQUAL(z_order(), "BNOTP");
+
+    show_window(back, true);
+    show_window(normal, true);
+    show_window(other, true);
+    ASSERT_STR_EQUAL(z_order(), "BNOTP");
+    ASSERT_EQUAL(find_window(5, 25), other);
+    show_window(top, true);
+    ASSERT_EQUAL(find_window(5, 25), top);
+    move_to_top(normal);
+    ASSERT_EQUAL(find_window(5, 25), top);
+    show_window(popup, true);
+    ASSERT_EQUAL(find_window(5, 25), popup);
+
+    // Removing the frontmost of a band leaves the one behind it on top
+    destroy_window(top);
+    destroy_window(popup);
+    ASSERT_STR_EQUAL(z_order(), "BON");
+    window_t *top2 = create_window("T", WINDOW_ALWAYSONTOP, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    destroy_window(normal);
+    window_t *normal2 = create_window("N", 0, MAKERECT(0, 20, 50, 50), NULL, plain_proc, NULL);
+    ASSERT_STR_EQUAL(z_order(), "BONT");
+    move_to_top(other);
+    move_to_top(back);
+    ASSERT_STR_EQUAL(z_order(), "BNOT");
+
+    // Children unlink themselves from their parent
+    window_t *a = create_window("a", 0, MAKERECT(0, 0, 5, 5), back, plain_proc, NULL);
+    window_t *b = create_window("b", 0, MAKERECT(0, 0, 5, 5), back, plain_proc, NULL);
+    window_t *c = create_window("c", 0, MAKERECT(0, 0, 5, 5), back, plain_proc, NULL);
+    destroy_window(b);
+    ASSERT_EQUAL(a->next, c);
+    ASSERT_EQUAL(c->prev, a);
+    destroy_window(c);
+    ASSERT_EQUAL(back->cold->last_child, a);
+    window_t *d = create_window("d", 0, MAKERECT(0, 0, 5, 5), back, plain_proc, NULL);
+    ASSERT_EQUAL(a->next, d);
+
+    destroy_window(top2);
+    destroy_window(normal2);
+    destroy_window(other);
+    destroy_window(back);
+    ASSERT_NULL(windows);
+    PASS();
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    TEST_START("Hit Testing");
+
+    test_top_level();
+    test_children();
+    test_layers();
+
+    TEST_END();
+}
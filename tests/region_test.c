@@ -0,0 +1,212 @@
+// Region and Damage Tests
+// Checks banded region math, that invalidate_rect only repaints the
+// children inside the damaged area, and window visible regions
+
+#include "test_framework.h"
+#include "../ui.h"
+#include "../kernel/software.h"
+
+static int child_paints[2];
+static int root_paints = 0;
+
+static bool rect_equal(rect_t const *a, int x, int y, int w, int h) {
+    return a->x == x && a->y == y && a->w == w && a->h == h;
+}
+
+void test_union_bands(void) {
+    TEST("Overlapping rects split into disjoint bands");
+    region_t rgn;
+    region_init(&rgn);
+    region_union_rect(&rgn, MAKERECT(0, 0, 10, 10));
+    region_union_rect(&rgn, MAKERECT(5, 5, 10, 10));
+    // Bands: [0,5) one rect, [5,10) merged span, [10,15) one rect
+    ASSERT_EQUAL(rgn.count, 3);
+    ASSERT_TRUE(rect_equal(&rgn.rects[0], 0, 0, 10, 5));
+    ASSERT_TRUE(rect_equal(&rgn.rects[1], 0, 5, 15, 5));
+    ASSERT_TRUE(rect_equal(&rgn.rects[2], 5, 10, 10, 5));
+    ASSERT_TRUE(region_contains_rect(&rgn, MAKERECT(2, 6, 12, 3)));
+    ASSERT_FALSE(region_contains_rect(&rgn, MAKERECT(10, 0, 2, 2)));
+    rect_t b = region_bounds(&rgn);
+    ASSERT_TRUE(rect_equal(&b, 0, 0, 15, 15));
+    region_free(&rgn);
+    PASS();
+}
+
+void test_union_coalesce(void) {
+    TEST("Touching rects merge and equal bands coalesce");
+    region_t rgn;
+    region_init(&rgn);
+    region_union_rect(&rgn, MAKERECT(0, 0, 4, 4));
+    region_union_rect(&rgn, MAKERECT(4, 0, 4, 4));
+    region_union_rect(&rgn, MAKERECT(0, 4, 8, 4));
+    ASSERT_EQUAL(rgn.count, 1);
+    ASSERT_TRUE(rect_equal(&rgn.rects[0], 0, 0, 8, 8));
+    // Two spans in one band stay separate
+    region_union_rect(&rgn, MAKERECT(20, 0, 2, 8));
+    ASSERT_EQUAL(rgn.count, 2);
+    ASSERT_TRUE(region_intersects(&rgn, MAKERECT(21, 7, 5, 5)));
+    ASSERT_FALSE(region_intersects(&rgn, MAKERECT(10, 0, 10, 8)));
+    region_free(&rgn);
+    PASS();
+}
+
+void test_intersect(void) {
+    TEST("Clipping keeps only the part inside the rect");
+    region_t rgn;
+    region_init(&rgn);
+    region_union_rect(&rgn, MAKERECT(0, 0, 10, 10));
+    region_union_rect(&rgn, MAKERECT(5, 5, 10, 10));
+    region_intersect_rect(&rgn, MAKERECT(0, 6, 8, 20));
+    ASSERT_EQUAL(rgn.count, 2);
+    ASSERT_TRUE(rect_equal(&rgn.rects[0], 0, 6, 8, 4));
+    ASSERT_TRUE(rect_equal(&rgn.rects[1], 5, 10, 3, 5));
+    region_intersect_rect(&rgn, MAKERECT(100, 100, 1, 1));
+    ASSERT_TRUE(region_is_empty(&rgn));
+    region_free(&rgn);
+    PASS();
+}
+
+void test_subtract(void) {
+    TEST("Subtracting a rect leaves the pieces around it");
+    region_t rgn;
+    region_init(&rgn);
+    region_union_rect(&rgn, MAKERECT(0, 0, 10, 10));
+    region_subtract_rect(&rgn, MAKERECT(3, 3, 4, 4));
+    // Bands: full top, left and right of the hole, full bottom
+    ASSERT_EQUAL(rgn.count, 4);
+    ASSERT_TRUE(rect_equal(&rgn.rects[0], 0, 0, 10, 3));
+    ASSERT_TRUE(rect_equal(&rgn.rects[1], 0, 3, 3, 4));
+    ASSERT_TRUE(rect_equal(&rgn.rects[2], 7, 3, 3, 4));
+    ASSERT_TRUE(rect_equal(&rgn.rects[3], 0, 7, 10, 3));
+    ASSERT_FALSE(region_intersects(&rgn, MAKERECT(3, 3, 4, 4)));
+    // Removing the right half joins nothing but drops the right pieces
+    region_subtract_rect(&rgn, MAKERECT(5, 0, 10, 10));
+    ASSERT_EQUAL(rgn.count, 3);
+    ASSERT_TRUE(region_contains_rect(&rgn, MAKERECT(0, 0, 3, 10)));
+    region_subtract_rect(&rgn, MAKERECT(-5, -5, 20, 20));
+    ASSERT_TRUE(region_is_empty(&rgn));
+    region_free(&rgn);
+    PASS();
+}
+
+static result_t child_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)wparam;
+    (void)lparam;
+    if (msg == kWindowMessagePaint) {
+        child_paints[win->id - 1]++;
+        return true;
+    }
+    return false;
+}
+
+static result_t root_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)win;
+    (void)wparam;
+    (void)lparam;
+    if (msg == kWindowMessagePaint) {
+        root_paints++;
+    }
+    return false;
+}
+
+void test_invalidate_rect(void) {
+    TEST("invalidate_rect repaints only damaged children");
+    ASSERT_TRUE(sw_init(NULL, 64, 64));
+    running = true;
+    window_t *root = create_window("Root", WINDOW_NOTITLE, MAKERECT(0, 0, 60, 60), NULL, root_proc, NULL);
+    window_t *a = create_window("A", 0, MAKERECT(4, 4, 10, 10), root, child_proc, NULL);
+    create_window("B", 0, MAKERECT(40, 40, 10, 10), root, child_proc, NULL);
+    ASSERT_EQUAL(a->id, 1);
+
+    // Child damage is stored in root client coordinates
+    invalidate_rect(a, MAKERECT(1, 1, 2, 2));
+    ASSERT_TRUE(region_contains_rect(&root->top->damage, MAKERECT(5, 5, 2, 2)));
+    ASSERT_FALSE(region_intersects(&root->top->damage, MAKERECT(40, 40, 10, 10)));
+
+    send_message(root, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(child_paints[0], 1);
+    ASSERT_EQUAL(child_paints[1], 0);
+    ASSERT_TRUE(region_is_empty(&root->top->damage));
+
+    // Damage over both children paints both in one procedure call each
+    invalidate_rect(root, MAKERECT(0, 0, 8, 8));
+    invalidate_rect(root, MAKERECT(45, 45, 2, 2));
+    send_message(root, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(child_paints[0], 2);
+    ASSERT_EQUAL(child_paints[1], 1);
+
+    // A whole-window invalidation is an ordinary paint
+    invalidate_window(root);
+    send_message(root, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(child_paints[0], 3);
+    ASSERT_EQUAL(child_paints[1], 2);
+
+    destroy_window(root);
+    running = false;
+    sw_shutdown();
+    PASS();
+}
+
+void test_visible_regions(void) {
+    TEST("Windows above clip the visible region; covered windows skip paints");
+    ASSERT_TRUE(sw_init(NULL, 64, 64));
+    running = true;
+    window_t *back = create_window("Back", WINDOW_NOTITLE, MAKERECT(0, 0, 30, 30), NULL, root_proc, NULL);
+    window_t *front = create_window("Front", WINDOW_NOTITLE, MAKERECT(20, 20, 30, 30), NULL, root_proc, NULL);
+    ASSERT_TRUE(region_is_empty(&back->top->visible_region));
+    show_window(back, true);
+    show_window(front, true);
+
+    // Outer rects include the frame one pixel outside the window
+    ASSERT_TRUE(region_contains_rect(&back->top->visible_region, MAKERECT(-1, -1, 20, 32)));
+    ASSERT_FALSE(region_intersects(&back->top->visible_region, MAKERECT(19, 19, 12, 12)));
+    ASSERT_TRUE(region_contains_rect(&front->top->visible_region, MAKERECT(19, 19, 32, 32)));
+
+    // Covering the back window entirely skips its paints
+    move_window(front, 0, 0);
+    ASSERT_TRUE(region_is_empty(&back->top->visible_region));
+    root_paints = 0;
+    send_message(back, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(root_paints, 0);
+
+    // Moving away uncovers it, and raising it clips the other one
+    move_window(front, 40, 40);
+    ASSERT_TRUE(region_contains_rect(&back->top->visible_region, MAKERECT(-1, -1, 32, 32)));
+    send_message(back, kWindowMessagePaint, 0, NULL);
+    ASSERT_EQUAL(root_paints, 1);
+    resize_window(front, 10, 10);
+    move_window(front, 25, 25);
+    move_to_top(back);
+    ASSERT_TRUE(region_contains_rect(&back->top->visible_region, MAKERECT(-1, -1, 32, 32)));
+    ASSERT_FALSE(region_intersects(&front->top->visible_region, MAKERECT(-1, -1, 32, 32)));
+    ASSERT_TRUE(region_contains_rect(&front->top->visible_region, MAKERECT(31, 24, 5, 12)));
+
+    // Showing raises a window; destroying it uncovers what was below
+    show_window(front, true);
+    ASSERT_FALSE(region_intersects(&back->top->visible_region, MAKERECT(24, 24, 12, 12)));
+    destroy_window(front);
+    ASSERT_TRUE(region_contains_rect(&back->top->visible_region, MAKERECT(-1, -1, 32, 32)));
+    show_window(back, false);
+    ASSERT_TRUE(region_is_empty(&back->top->visible_region));
+
+    destroy_window(back);
+    running = false;
+    sw_shutdown();
+    PASS();
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    TEST_START("Regions and Damage");
+
+    test_union_bands();
+    test_union_coalesce();
+    test_intersect();
+    test_subtract();
+    test_invalidate_rect();
+    test_visible_regions();
+
+    TEST_END();
+}
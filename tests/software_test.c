@@ -0,0 +1,147 @@
+// Software Rasterizer Tests
+// Draws into the CPU framebuffer without a window and checks the pixels
+
+#include <time.h>
+
+#include "test_framework.h"
+#include "test_env.h"
+#include "../ui.h"
+#include "../kernel/software.h"
+
+#define FB_WIDTH 37   // Odd size so SIMD spans leave a scalar tail
+#define FB_HEIGHT 20
+
+#define RED    0xFF0000FF
+#define GREEN  0xFF00FF00
+#define BLUE   0xFFFF0000
+#define BLACK  0xFF000000
+
+static GLuint white_tex;
+
+static void fill(int x, int y, int w, int h, uint32_t col) {
+    sw_draw_sprites(white_tex, &(sprite_instance_t) { x, y, w, h, 0, 0, 0, 0, col }, 1);
+}
+
+void test_init(void) {
+    TEST("Framebuffer without a window");
+    ASSERT_TRUE(sw_init(NULL, FB_WIDTH, FB_HEIGHT));
+    ASSERT_TRUE(sw_enabled());
+    uint32_t white = 0xFFFFFFFF;
+    white_tex = sw_create_texture(1, 1, GL_RGBA, &white);
+    ASSERT_NOT_EQUAL(white_tex, 0);
+    ASSERT_EQUAL(test_env_pixel(0, 0), BLACK);
+    PASS();
+}
+
+void test_opaque_fill(void) {
+    TEST("Opaque fill covers exactly the rect");
+    test_env_clear(BLACK);
+    fill(3, 2, 30, 5, RED);
+    ASSERT_EQUAL(test_env_pixel(3, 2), RED);
+    ASSERT_EQUAL(test_env_pixel(32, 6), RED);
+    ASSERT_EQUAL(test_env_pixel(2, 2), BLACK);
+    ASSERT_EQUAL(test_env_pixel(33, 2), BLACK);
+    ASSERT_EQUAL(test_env_pixel(3, 7), BLACK);
+    PASS();
+}
+
+void test_blend(void) {
+    TEST("Translucent fill blends with SRC_ALPHA");
+    test_env_clear(BLACK);
+    fill(0, 0, FB_WIDTH, 1, 0x800000FF);
+    uint32_t p = test_env_pixel(FB_WIDTH - 1, 0);
+    ASSERT_EQUAL(p & 0xFF, 0x80);
+    ASSERT_EQUAL((p >> 8) & 0xFF, 0);
+    ASSERT_EQUAL(test_env_pixel(0, 0), p);
+    PASS();
+}
+
+void test_discard(void) {
+    TEST("Nearly transparent fill is discarded");
+    test_env_clear(BLACK);
+    fill(0, 0, FB_WIDTH, FB_HEIGHT, 0x19FFFFFF);
+    ASSERT_EQUAL(test_env_pixel(5, 5), BLACK);
+    PASS();
+}
+
+void test_scissor_and_viewport(void) {
+    TEST("Scissor and viewport clip with a bottom-left origin");
+    test_env_clear(BLACK);
+    // Top 4 rows of the framebuffer
+    sw_set_cap(GL_SCISSOR_TEST, true);
+    sw_scissor(0, FB_HEIGHT - 4, FB_WIDTH, 4);
+    fill(0, 0, FB_WIDTH, FB_HEIGHT, GREEN);
+    ASSERT_EQUAL(test_env_pixel(10, 3), GREEN);
+    ASSERT_EQUAL(test_env_pixel(10, 4), BLACK);
+    sw_set_cap(GL_SCISSOR_TEST, false);
+
+    // Viewport with a scrolled projection moves the origin
+    sw_viewport(10, 0, 10, FB_HEIGHT);
+    sw_projection(5, 0, 15, FB_HEIGHT);
+    fill(5, 10, 1, 1, BLUE);
+    ASSERT_EQUAL(test_env_pixel(10, 10), BLUE);
+    ASSERT_EQUAL(test_env_pixel(9, 10), BLACK);
+    PASS();
+}
+
+void test_texture_source_rect(void) {
+    TEST("Alpha textures sample the texel source rect");
+    // 4x2 alpha texture; right half opaque
+    uint8_t alpha[] = { 0, 0, 255, 255,
+                        0, 0, 255, 255 };
+    GLuint tex = sw_create_texture(4, 2, GL_RED, alpha);
+    ASSERT_NOT_EQUAL(tex, 0);
+    test_env_clear(BLACK);
+    sw_draw_sprites(tex, &(sprite_instance_t) { 0, 0, 4, 2, 0, 0, 4, 2, RED }, 1);
+    ASSERT_EQUAL(test_env_pixel(1, 1), BLACK);
+    ASSERT_EQUAL(test_env_pixel(2, 1), RED);
+    // Only the opaque half, stretched over 4 pixels
+    sw_draw_sprites(tex, &(sprite_instance_t) { 0, 5, 4, 2, 2, 0, 2, 2, BLUE }, 1);
+    ASSERT_EQUAL(test_env_pixel(0, 5), BLUE);
+    ASSERT_EQUAL(test_env_pixel(3, 6), BLUE);
+    sw_delete_texture(tex);
+    PASS();
+}
+
+void test_desktop_speed(void) {
+    TEST("Full 480x320 desktop repaints at 100+ fps of CPU time");
+    ASSERT_TRUE(sw_init(NULL, 480, 320));
+    uint32_t white = 0xFFFFFFFF;
+    white_tex = sw_create_texture(1, 1, GL_RGBA, &white);
+    enum { FRAMES = 200 };
+    clock_t start = clock();
+    for (int i = 0; i < FRAMES; i++) {
+        sprite_instance_t rects[] = {
+            { 0, 0, 480, 320, 0, 0, 0, 0, 0xff6B3529 },
+            { 40, 30, 200, 150, 0, 0, 0, 0, 0xff3c3c3c },
+            { 260, 60, 180, 220, 0, 0, 0, 0, 0xff3c3c3c },
+            { 100, 100, 300, 100, 0, 0, 0, 0, 0x80FFFFFF },
+        };
+        sw_draw_sprites(white_tex, rects, sizeof(rects) / sizeof(rects[0]));
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("(%.0f fps) ", seconds > 0 ? FRAMES / seconds : 0.0);
+    // Loose enough for sanitizer and debug builds
+    ASSERT_TRUE(seconds < FRAMES / 100.0);
+    ASSERT_EQUAL(test_env_pixel(0, 0), 0xff6B3529);
+    PASS();
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    TEST_START("Software Rasterizer");
+
+    test_init();
+    test_opaque_fill();
+    test_blend();
+    test_discard();
+    test_scissor_and_viewport();
+    test_texture_source_rect();
+    test_desktop_speed();
+
+    sw_shutdown();
+
+    TEST_END();
+}
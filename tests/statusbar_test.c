@@ -78,13 +78,13 @@ int main(int argc, char *argv[]) {
         TEST_PASS("Window with status bar flag created successfully");
         
         // Test 7: statusbar_text field exists and is initialized
-        TEST_ASSERT(strlen(win->statusbar_text) == 0, "statusbar_text is initially empty");
+        TEST_ASSERT(strlen(win->top->statusbar_text) == 0, "statusbar_text is initially empty");
         TEST_PASS("statusbar_text field is initialized correctly");
         
         // Test 8: Send kWindowMessageStatusBar message
         const char *test_text = "Test Status";
         send_message(win, kWindowMessageStatusBar, 0, (void*)test_text);
-        TEST_ASSERT(strcmp(win->statusbar_text, test_text) == 0, "kWindowMessageStatusBar updates statusbar_text");
+        TEST_ASSERT(strcmp(win->top->statusbar_text, test_text) == 0, "kWindowMessageStatusBar updates statusbar_text");
         TEST_PASS("kWindowMessageStatusBar message handler works correctly");
         
         // Test 9: statusbar_text truncation
@@ -92,8 +92,8 @@ int main(int argc, char *argv[]) {
         memset(long_text, 'X', sizeof(long_text) - 1);
         long_text[sizeof(long_text) - 1] = '\0';
         send_message(win, kWindowMessageStatusBar, 0, (void*)long_text);
-        TEST_ASSERT(strlen(win->statusbar_text) < sizeof(long_text), "statusbar_text is properly truncated");
-        TEST_ASSERT(strlen(win->statusbar_text) < 64, "statusbar_text respects buffer size");
+        TEST_ASSERT(strlen(win->top->statusbar_text) < sizeof(long_text), "statusbar_text is properly truncated");
+        TEST_ASSERT(strlen(win->top->statusbar_text) < 64, "statusbar_text respects buffer size");
         TEST_PASS("Long status text is properly truncated");
         
         destroy_window(win);
@@ -2,6 +2,7 @@
 #include "test_framework.h"
 #include "test_env.h"
 #include "../ui.h"
+#include "../kernel/software.h"
 #include <string.h>
 
 void test_terminal_has_vscroll_flag(void) {
@@ -25,6 +26,59 @@ void test_terminal_has_vscroll_flag(void) {
   PASS();
 }
 
+// Helper: Run a terminal command
+static void send_command(window_t *win, const char *text) {
+  for (const char *p = text; *p != '\0'; p++) {
+    char c = *p;
+    send_message(win, kWindowMessageTextInput, 0, &c);
+  }
+  send_message(win, kWindowMessageKeyDown, SDL_SCANCODE_RETURN, NULL);
+}
+
+void test_terminal_wheel(void) {
+  TEST("Terminal scrolls its text, not the window");
+  
+  test_env_init();
+  // Text is laid out with the font, which needs a framebuffer
+  ASSERT_TRUE(sw_init(NULL, 64, 64));
+  init_text_rendering();
+  
+  rect_t frame = {10, 10, 300, 150};
+  window_t *terminal = create_window("Terminal Wheel Test", 0, &frame, NULL, win_terminal, NULL);
+  ASSERT_NOT_NULL(terminal);
+  for (int i = 0; i < 20; i++) {
+    send_command(terminal, "help");
+  }
+  int width = frame.w - WINDOW_PADDING * 2;
+  int limit = calc_text_height(terminal_get_buffer(terminal), width) - (frame.h - WINDOW_PADDING * 2);
+  ASSERT_TRUE(limit > 120);
+  
+  // The terminal keeps its own offset, which may pass the 16-bit window scroll
+  ASSERT_EQUAL(terminal_get_scroll(terminal), 0);
+  ASSERT_TRUE(send_message(terminal, kWindowMessageWheel, MAKEDWORD(0, -120), NULL));
+  ASSERT_EQUAL(terminal_get_scroll(terminal), 120);
+  ASSERT_EQUAL(terminal->scroll[1], 0);
+  
+  // Clamped to the text below and the top above
+  send_message(terminal, kWindowMessageWheel, MAKEDWORD(0, -30000), NULL);
+  ASSERT_EQUAL(terminal_get_scroll(terminal), limit);
+  send_message(terminal, kWindowMessageWheel, MAKEDWORD(0, 30000), NULL);
+  ASSERT_EQUAL(terminal_get_scroll(terminal), 0);
+  ASSERT_EQUAL(terminal->scroll[1], 0);
+  
+  // Clearing the output scrolls back to the top
+  send_message(terminal, kWindowMessageWheel, MAKEDWORD(0, -120), NULL);
+  ASSERT_EQUAL(terminal_get_scroll(terminal), 120);
+  send_command(terminal, "clear");
+  ASSERT_EQUAL(terminal_get_scroll(terminal), 0);
+  
+  destroy_window(terminal);
+  shutdown_text_rendering();
+  sw_shutdown();
+  test_env_shutdown();
+  PASS();
+}
+
 void test_text_wrapping_calculation(void) {
   TEST("Text height calculation with wrapping");
   
@@ -45,6 +99,7 @@ int main(int argc, char *argv[]) {
   TEST_START("Terminal Scrolling Tests");
   
   test_terminal_has_vscroll_flag();
+  test_terminal_wheel();
   test_text_wrapping_calculation();
   
   TEST_END();
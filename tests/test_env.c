@@ -2,6 +2,7 @@
 // Provides utilities to create windows, send messages, and track events
 
 #include "test_env.h"
+#include "../kernel/software.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -133,3 +134,22 @@ int test_env_send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lp
 void test_env_post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
     post_message(win, msg, wparam, lparam);
 }
+
+// Helper: Read a pixel of the software framebuffer
+uint32_t test_env_pixel(int x, int y) {
+    int w;
+    uint32_t *fb = sw_framebuffer(&w, NULL);
+    return fb[y * w + x];
+}
+
+// Helper: Fill the software framebuffer and reset the state drawing depends on
+void test_env_clear(uint32_t col) {
+    int w, h;
+    uint32_t *fb = sw_framebuffer(&w, &h);
+    set_projection(0, 0, w, h);
+    sw_viewport(0, 0, w, h);
+    sw_set_cap(GL_SCISSOR_TEST, false);
+    for (int i = 0; i < w * h; i++) {
+        fb[i] = col;
+    }
+}
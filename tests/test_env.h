@@ -70,4 +70,11 @@ int test_env_send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lp
 // Helper: Post a tracked message
 void test_env_post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
 
+// Helper: Read a pixel of the software framebuffer
+uint32_t test_env_pixel(int x, int y);
+
+// Helper: Fill the software framebuffer with a color and reset the viewport,
+// projection and scissor to cover all of it
+void test_env_clear(uint32_t col);
+
 #endif // __TEST_ENV_H__
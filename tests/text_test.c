@@ -0,0 +1,337 @@
+// Text Tests
+// Draws small-font text on the software rasterizer and checks that cached
+// glyph runs land where uncached ones would, per color, within the cache cap,
+// that long text streamed as glyph instances draws the same, that text
+// layouts wrap like draw_text_wrapped while drawing only visible lines, and
+// that text taller than 16-bit coordinates still scrolls into view
+
+#include "test_framework.h"
+#include "test_env.h"
+#include "../ui.h"
+#include "../kernel/software.h"
+
+#define FB_WIDTH 64
+#define FB_HEIGHT 32
+
+#define WHITE  0xFFFFFFFF
+#define RED    0xFF0000FF
+#define BLACK  0xFF000000
+
+extern size_t text_cache_size(void);
+
+// Lit pixels of a 16x8 block as a bitmask per row
+static void snapshot(int x, int y, uint32_t rows[8]) {
+    for (int j = 0; j < 8; j++) {
+        rows[j] = 0;
+        for (int i = 0; i < 16; i++) {
+            if (test_env_pixel(x + i, y + j) != BLACK) rows[j] |= 1u << i;
+        }
+    }
+}
+
+void test_setup(void) {
+    TEST("Font atlas on the software framebuffer");
+    ASSERT_TRUE(sw_init(NULL, FB_WIDTH, FB_HEIGHT));
+    sw_viewport(0, 0, FB_WIDTH, FB_HEIGHT);
+    running = true;
+    init_text_rendering();
+    set_projection(0, 0, FB_WIDTH, FB_HEIGHT);
+    ASSERT_EQUAL(text_cache_size(), 0);
+    PASS();
+}
+
+void test_cached_runs(void) {
+    TEST("A cached run draws the same glyphs at a new position");
+    uint32_t first[8], second[8];
+    test_env_clear(BLACK);
+    draw_text_small("Hi", 1, 1, WHITE);
+    flush_sprites();
+    snapshot(1, 1, first);
+    size_t size = text_cache_size();
+    ASSERT_TRUE(size > 0);
+    ASSERT_TRUE(first[0] || first[1] || first[2]);
+
+    test_env_clear(BLACK);
+    draw_text_small("Hi", 30, 20, WHITE);
+    flush_sprites();
+    snapshot(30, 20, second);
+    ASSERT_EQUAL(text_cache_size(), size);
+    ASSERT_EQUAL(memcmp(first, second, sizeof(first)), 0);
+    PASS();
+}
+
+void test_run_colors(void) {
+    TEST("Each color gets its own run");
+    size_t size = text_cache_size();
+    test_env_clear(BLACK);
+    draw_text_small("Hi", 1, 1, RED);
+    flush_sprites();
+    ASSERT_TRUE(text_cache_size() > size);
+    bool red = false, white = false;
+    for (int y = 1; y < 9; y++) {
+        for (int x = 1; x < 17; x++) {
+            red |= test_env_pixel(x, y) == RED;
+            white |= test_env_pixel(x, y) == WHITE;
+        }
+    }
+    ASSERT_TRUE(red);
+    ASSERT_FALSE(white);
+    PASS();
+}
+
+void test_cache_limit(void) {
+    TEST("Old runs are evicted and long text isn't cached");
+    char label[32];
+    size_t largest = 0;
+    for (int i = 0; i < 20000; i++) {
+        snprintf(label, sizeof(label), "Label number %d", i);
+        draw_text_small(label, 0, 0, WHITE);
+        largest = MAX(largest, text_cache_size());
+    }
+    flush_sprites();
+    ASSERT_TRUE(largest <= 256 * 1024);
+
+    char line[400];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    size_t size = text_cache_size();
+    draw_text_small(line, 0, 0, WHITE);
+    flush_sprites();
+    ASSERT_EQUAL(text_cache_size(), size);
+
+    // Evicted text draws as before
+    uint32_t first[8], second[8];
+    test_env_clear(BLACK);
+    draw_text_small("Label number 0", 1, 1, WHITE);
+    flush_sprites();
+    snapshot(1, 1, first);
+    test_env_clear(BLACK);
+    draw_text_small("Label number 0", 1, 1, WHITE);
+    flush_sprites();
+    snapshot(1, 1, second);
+    ASSERT_EQUAL(memcmp(first, second, sizeof(first)), 0);
+    ASSERT_TRUE(first[1] != 0);
+    PASS();
+}
+
+void test_streamed_text(void) {
+    TEST("Long text streams as glyphs past 4096 characters");
+    uint32_t cached[8], streamed[8];
+    test_env_clear(BLACK);
+    draw_text_small("Hi", 1, 1, WHITE);
+    flush_sprites();
+    snapshot(1, 1, cached);
+
+    // Push "Hi" onto the screen from the end of a very long line
+    int n = 5000;
+    char *text = malloc(n + 3);
+    ASSERT_NOT_NULL(text);
+    memset(text, 'x', n);
+    strcpy(text + n, "Hi");
+    rect_t viewport = { 1 - n * strwidth("x"), 1, 100000, 16 };
+    test_env_clear(BLACK);
+    draw_text_wrapped(text, &viewport, WHITE);
+    flush_sprites();
+    snapshot(1, 1, streamed);
+    ASSERT_EQUAL(memcmp(cached, streamed, sizeof(cached)), 0);
+
+    // Recorded glyphs replay the same
+    test_env_clear(BLACK);
+    display_list_t *list = begin_display_list(NULL);
+    draw_text_wrapped(text, &viewport, WHITE);
+    end_display_list();
+    test_env_clear(BLACK);
+    replay_display_list(list);
+    flush_sprites();
+    snapshot(1, 1, streamed);
+    ASSERT_EQUAL(memcmp(cached, streamed, sizeof(cached)), 0);
+    free_display_list(list);
+    free(text);
+    PASS();
+}
+
+void test_glyph_palette(void) {
+    TEST("Glyph colors beyond one palette start a new batch");
+    rect_t viewport = { 1, 1, 60, 16 };
+    test_env_clear(BLACK);
+    for (int i = 0; i < 20; i++) {
+        draw_text_wrapped("Hi", &viewport, 0xFF000000 | (i * 10));
+    }
+    flush_sprites();
+    bool last = false;
+    for (int y = 1; y < 9; y++) {
+        for (int x = 1; x < 17; x++) {
+            last |= test_env_pixel(x, y) == (0xFF000000 | 190);
+        }
+    }
+    ASSERT_TRUE(last);
+    PASS();
+}
+
+void test_layout_incremental(void) {
+    TEST("Text layouts extend as text is appended");
+    char text[256] = "first line\nsecond line that wraps around\n";
+    text_layout_t layout = {0};
+    update_text_layout(&layout, text, strlen(text), 60);
+    ASSERT_EQUAL(text_layout_height(&layout), calc_text_height(text, 60));
+    int lines = layout.num_lines;
+
+    strcat(text, "third");
+    update_text_layout(&layout, text, strlen(text), 60);
+    ASSERT_EQUAL(layout.num_lines, lines);
+    strcat(text, " line goes on for a while");
+    update_text_layout(&layout, text, strlen(text), 60);
+    ASSERT_EQUAL(text_layout_height(&layout), calc_text_height(text, 60));
+    ASSERT_TRUE(layout.num_lines > lines);
+
+    // A new width lays the text out again
+    update_text_layout(&layout, text, strlen(text), 200);
+    ASSERT_EQUAL(text_layout_height(&layout), calc_text_height(text, 200));
+    reset_text_layout(&layout);
+    update_text_layout(&layout, "x", 1, 200);
+    ASSERT_EQUAL(layout.num_lines, 1);
+    free_text_layout(&layout);
+    ASSERT_NULL(layout.lines);
+    PASS();
+}
+
+void test_layout_visible_lines(void) {
+    TEST("Laid out text draws only its visible lines, as wrapped text would");
+    char text[4096] = "";
+    for (int i = 0; i < 200; i++) {
+        strcat(text, i % 3 ? "Hi there\n" : "Hi there, a line too long for one row\n");
+    }
+    text_layout_t layout = {0};
+    update_text_layout(&layout, text, strlen(text), 50);
+    int height = text_layout_height(&layout);
+    ASSERT_TRUE(height > FB_HEIGHT * 10);
+
+    // Scroll to the end: both put the same glyphs on screen
+    uint32_t wrapped[8], laid_out[8];
+    rect_t viewport = { 2, FB_HEIGHT - height, 50, height };
+    test_env_clear(BLACK);
+    draw_text_wrapped(text, &viewport, WHITE);
+    flush_sprites();
+    snapshot(2, 8, wrapped);
+    test_env_clear(BLACK);
+    rect_t visible = { 2, 0, 50, FB_HEIGHT };
+    draw_text_layout(&layout, text, &visible, height - FB_HEIGHT, WHITE);
+    flush_sprites();
+    snapshot(2, 8, laid_out);
+    ASSERT_EQUAL(memcmp(wrapped, laid_out, sizeof(wrapped)), 0);
+    ASSERT_TRUE(laid_out[1] != 0);
+
+    // Lines outside the viewport aren't drawn, laid out or wrapped
+    rect_t top = { 2, 0, 50, 8 };
+    rect_t above = { 2, FB_HEIGHT - height, 50, height - FB_HEIGHT + 8 };
+    for (int i = 0; i < 2; i++) {
+        test_env_clear(BLACK);
+        if (i == 0) {
+            draw_text_layout(&layout, text, &top, height - FB_HEIGHT, WHITE);
+        } else {
+            draw_text_wrapped(text, &above, WHITE);
+        }
+        flush_sprites();
+        bool below = false;
+        for (int y = 8; y < FB_HEIGHT; y++) {
+            for (int x = 0; x < FB_WIDTH; x++) {
+                below |= test_env_pixel(x, y) != BLACK;
+            }
+        }
+        ASSERT_FALSE(below);
+    }
+    free_text_layout(&layout);
+    PASS();
+}
+
+void test_tall_layout(void) {
+    TEST("Text taller than 16-bit coordinates scrolls to its last lines");
+    int n = 8000;
+    char *text = malloc(n * 3 + 3);
+    ASSERT_NOT_NULL(text);
+    for (int i = 0; i < n; i++) {
+        memcpy(text + i * 3, "x\n\n", 3);
+    }
+    strcpy(text + n * 3, "Hi");
+    text_layout_t layout = {0};
+    update_text_layout(&layout, text, strlen(text), 50);
+    int height = text_layout_height(&layout);
+    ASSERT_TRUE(height > INT16_MAX * 2);
+
+    uint32_t expected[8], scrolled[8];
+    test_env_clear(BLACK);
+    draw_text_small("Hi", 2, 1, WHITE);
+    flush_sprites();
+    snapshot(2, 1, expected);
+
+    // The last line lands at the top of the viewport, nothing wraps around
+    rect_t viewport = { 2, 1, 50, FB_HEIGHT - 1 };
+    test_env_clear(BLACK);
+    int line = height / layout.num_lines;
+    draw_text_layout(&layout, text, &viewport, height - line, WHITE);
+    flush_sprites();
+    snapshot(2, 1, scrolled);
+    ASSERT_EQUAL(memcmp(expected, scrolled, sizeof(expected)), 0);
+    ASSERT_TRUE(scrolled[1] != 0);
+    free_text_layout(&layout);
+    free(text);
+    PASS();
+}
+
+void test_wide_line(void) {
+    TEST("Glyphs past 16-bit x coordinates are dropped, not wrapped");
+    // Long enough to run past x = 65536 + FB_WIDTH from off the right edge
+    int n = (65536 + FB_WIDTH * 2) / strwidth("x") + 1;
+    char *text = malloc(n + 1);
+    ASSERT_NOT_NULL(text);
+    memset(text, 'x', n);
+    text[n] = '\0';
+    test_env_clear(BLACK);
+    draw_text_small(text, FB_WIDTH, 1, WHITE);
+    rect_t viewport = { FB_WIDTH, 10, 0, 16 };
+    draw_text_wrapped(text, &viewport, WHITE);
+    // ...and from below x = -65536 across it
+    text[(FB_WIDTH * 3) / strwidth("x")] = '\0';
+    viewport.x = -65536 - FB_WIDTH;
+    draw_text_wrapped(text, &viewport, WHITE);
+    flush_sprites();
+    bool lit = false;
+    for (int y = 0; y < FB_HEIGHT; y++) {
+        for (int x = 0; x < FB_WIDTH; x++) {
+            lit |= test_env_pixel(x, y) != BLACK;
+        }
+    }
+    ASSERT_FALSE(lit);
+    free(text);
+    PASS();
+}
+
+void test_shutdown(void) {
+    TEST("Shutting down text rendering empties the cache");
+    shutdown_text_rendering();
+    ASSERT_EQUAL(text_cache_size(), 0);
+    running = false;
+    sw_shutdown();
+    PASS();
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    TEST_START("Text Rendering");
+
+    test_setup();
+    test_cached_runs();
+    test_run_colors();
+    test_cache_limit();
+    test_streamed_text();
+    test_glyph_palette();
+    test_layout_incremental();
+    test_layout_visible_lines();
+    test_tall_layout();
+    test_wide_line();
+    test_shutdown();
+
+    TEST_END();
+}
@@ -56,7 +56,7 @@ void test_window_creation_tracked(void) {
                                             test_window_proc, NULL);
     
     ASSERT_NOT_NULL(win);
-    ASSERT_STR_EQUAL(win->title, "Test Window");
+    ASSERT_STR_EQUAL(win->cold->title, "Test Window");
     
     // Verify kWindowMessageCreate was called
     ASSERT_EQUAL(test_wm_create_called, 1);
@@ -272,6 +272,435 @@ void test_clear_events(void) {
     PASS();
 }
 
+// Test top-level window IDs past the old 255-window limit
+void test_many_window_ids(void) {
+    TEST("Thousands of top-level windows get unique, reused IDs");
+    
+    enum { NUM_WINDOWS = 1000 };
+    static window_t *wins[NUM_WINDOWS];
+    for (int i = 0; i < NUM_WINDOWS; i++) {
+        wins[i] = create_window("Many", 0, MAKERECT(0, 0, 10, 10), NULL, test_window_proc, NULL);
+        ASSERT_NOT_NULL(wins[i]);
+        ASSERT_EQUAL(wins[i]->id, (uint32_t)i + 1);
+    }
+    
+    // Freed IDs are handed out again, lowest first
+    destroy_window(wins[700]);
+    destroy_window(wins[41]);
+    window_t *a = create_window("Reuse", 0, MAKERECT(0, 0, 10, 10), NULL, test_window_proc, NULL);
+    window_t *b = create_window("Reuse", 0, MAKERECT(0, 0, 10, 10), NULL, test_window_proc, NULL);
+    ASSERT_EQUAL(a->id, 42);
+    ASSERT_EQUAL(b->id, 701);
+    wins[41] = a;
+    wins[700] = b;
+    
+    for (int i = 0; i < NUM_WINDOWS; i++) {
+        destroy_window(wins[i]);
+    }
+    window_t *first = create_window("First", 0, MAKERECT(0, 0, 10, 10), NULL, test_window_proc, NULL);
+    ASSERT_EQUAL(first->id, 1);
+    destroy_window(first);
+    PASS();
+}
+
+// Test that get_message only sleeps when there is nothing to repost
+void test_idle_wait(void) {
+    TEST("get_message polls while messages are queued or the app is quitting");
+    extern bool has_pending_messages(void);
+    
+    window_t *win = create_window("Idle", 0, MAKERECT(0, 0, 10, 10), NULL, test_window_proc, NULL);
+    post_message(win, kWindowMessageCommand, 0, NULL);
+    ASSERT_TRUE(has_pending_messages());
+    
+    ui_event_t e;
+    uint32_t start = SDL_GetTicks();
+    ASSERT_EQUAL(get_message(&e), 0);
+    ASSERT_TRUE(SDL_GetTicks() - start < 500);
+    
+    repost_messages();
+    ASSERT_FALSE(has_pending_messages());
+    
+    // Nothing queued, but with running false the loop must get to exit
+    ASSERT_FALSE(running);
+    start = SDL_GetTicks();
+    ASSERT_EQUAL(get_message(&e), 0);
+    ASSERT_TRUE(SDL_GetTicks() - start < 500);
+    
+    destroy_window(win);
+    PASS();
+}
+
+// Frame scheduler ordering
+static char frame_log[16];
+static int frame_log_len = 0;
+
+static result_t frame_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)wparam;
+    (void)lparam;
+    char c = 0;
+    switch (msg) {
+        case kWindowMessageCommand: c = 'c'; break;
+        case kWindowMessageNonClientPaint: c = 'n'; break;
+        case kWindowMessagePaint:
+            c = win->parent ? 'p' : 'P';
+            // Posted while painting, so handled next frame
+            if (!win->parent) post_message(win, kWindowMessageCommand, 0, NULL);
+            break;
+    }
+    if (c && frame_log_len < (int)sizeof(frame_log) - 1) {
+        frame_log[frame_log_len++] = c;
+    }
+    return false;
+}
+
+void test_frame_scheduler(void) {
+    TEST("Frames send state messages first and coalesce paints");
+    extern bool has_pending_messages(void);
+    
+    window_t *root = create_window("Root", 0, MAKERECT(0, 0, 50, 50), NULL, frame_proc, NULL);
+    window_t *child = create_window("Child", 0, MAKERECT(0, 0, 10, 10), root, frame_proc, NULL);
+    repost_messages();
+    repost_messages();
+    memset(frame_log, 0, sizeof(frame_log));
+    frame_log_len = 0;
+    
+    // The child's own paint is dropped since the root repaints it
+    invalidate_window(child);
+    invalidate_window(root);
+    post_message(root, kWindowMessageCommand, 0, NULL);
+    repost_messages();
+    ASSERT_STR_EQUAL(frame_log, "cnPp");
+    ASSERT_TRUE(has_pending_messages());
+    repost_messages();
+    ASSERT_STR_EQUAL(frame_log, "cnPpc");
+    ASSERT_FALSE(has_pending_messages());
+    
+    destroy_window(root);
+    PASS();
+}
+
+// Priority lanes
+static bool lane_post_on_paint = false;
+
+static result_t lane_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)wparam;
+    (void)lparam;
+    char c = 0;
+    switch (msg) {
+        case kWindowMessageKeyDown: c = 'k'; break;
+        case kWindowMessageCommand: c = 'c'; break;
+        case kWindowMessageNonClientPaint: c = 'n'; break;
+        case kWindowMessagePaint:
+            c = 'P';
+            if (lane_post_on_paint) {
+                lane_post_on_paint = false;
+                post_message(win, kWindowMessageCommand, 0, NULL);
+            }
+            break;
+        case kWindowMessageUser + 100: c = 'i'; break;
+    }
+    if (c && frame_log_len < (int)sizeof(frame_log) - 1) {
+        frame_log[frame_log_len++] = c;
+    }
+    return false;
+}
+
+void test_message_lanes(void) {
+    TEST("Input runs first, paint after state changes, idle last");
+    
+    window_t *win = create_window("Lanes", 0, MAKERECT(0, 0, 50, 50), NULL, lane_proc, NULL);
+    repost_messages();
+    memset(frame_log, 0, sizeof(frame_log));
+    frame_log_len = 0;
+    
+    post_idle_message(win, kWindowMessageUser + 100, 0, NULL);
+    invalidate_window(win);
+    post_message(win, kWindowMessageCommand, 0, NULL);
+    post_message(win, kWindowMessageKeyDown, 0, NULL);
+    lane_post_on_paint = true;
+    repost_messages();
+    // The command posted while painting keeps the idle message waiting
+    ASSERT_STR_EQUAL(frame_log, "kcnP");
+    repost_messages();
+    ASSERT_STR_EQUAL(frame_log, "kcnPci");
+    
+    destroy_window(win);
+    PASS();
+}
+
+// Queue growth and duplicate suppression; past the control messages
+#define TEST_MESSAGE_BASE (kWindowMessageUser + 100)
+
+static int user_messages = 0;
+
+static result_t counting_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)win;
+    (void)lparam;
+    if (msg >= TEST_MESSAGE_BASE && wparam == 2) {
+        user_messages++;
+    }
+    return false;
+}
+
+void test_message_queue_growth(void) {
+    TEST("Message queue grows past 256 and coalesces duplicates");
+    
+    window_t *win = create_window("Queue", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+    window_t *gone = create_window("Gone", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+    repost_messages();
+    message_queue_stats_t before = get_message_queue_stats();
+    
+    for (int i = 0; i < 1000; i++) {
+        post_message(win, TEST_MESSAGE_BASE + i, 1, NULL);
+        post_message(gone, TEST_MESSAGE_BASE + i, 2, NULL);
+    }
+    // The newer duplicate wins
+    for (int i = 0; i < 1000; i++) {
+        post_message(win, TEST_MESSAGE_BASE + i, 2, NULL);
+    }
+    message_queue_stats_t after = get_message_queue_stats();
+    ASSERT_EQUAL(after.posted - before.posted, 3000);
+    ASSERT_EQUAL(after.coalesced - before.coalesced, 1000);
+    ASSERT_EQUAL(after.dropped, 0);
+    ASSERT_TRUE(after.capacity >= 3000);
+    ASSERT_TRUE(after.high_water >= 3000);
+    
+    // A destroyed window's messages are dropped
+    destroy_window(gone);
+    user_messages = 0;
+    repost_messages();
+    ASSERT_EQUAL(user_messages, 1000);
+    
+    destroy_window(win);
+    PASS();
+}
+
+static result_t busy_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)wparam;
+    (void)lparam;
+    // Always leaves work for the next frame, so idle messages never run
+    if (msg == kWindowMessageCommand) {
+        post_message(win, kWindowMessageCommand, 0, NULL);
+    }
+    return false;
+}
+
+void test_waiting_idle_message(void) {
+    TEST("A waiting idle message doesn't grow the queue");
+    extern bool has_pending_messages(void);
+    
+    window_t *win = create_window("Busy", 0, MAKERECT(0, 0, 10, 10), NULL, busy_proc, NULL);
+    repost_messages();
+    post_idle_message(win, TEST_MESSAGE_BASE, 0, NULL);
+    post_message(win, kWindowMessageCommand, 0, NULL);
+    repost_messages();
+    uint32_t capacity = get_message_queue_stats().capacity;
+    
+    for (int frame = 0; frame < 100; frame++) {
+        for (int i = 1; i <= 200; i++) {
+            post_message(win, TEST_MESSAGE_BASE + i, 0, NULL);
+        }
+        repost_messages();
+    }
+    ASSERT_EQUAL(get_message_queue_stats().capacity, capacity);
+    ASSERT_TRUE(has_pending_messages());
+    
+    destroy_window(win);
+    PASS();
+}
+
+static int nested_idle_sends = 0;
+
+static result_t nested_proc(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+    (void)lparam;
+    if (msg == TEST_MESSAGE_BASE + 1) {
+        // A modal loop: runs a frame of its own that leaves a command waiting
+        post_message(win, kWindowMessageCommand, 1, NULL);
+        repost_messages();
+    } else if (msg == kWindowMessageCommand && wparam == 1) {
+        post_message(win, kWindowMessageCommand, 0, NULL);
+    } else if (msg == TEST_MESSAGE_BASE + 2) {
+        nested_idle_sends++;
+    }
+    return false;
+}
+
+void test_nested_frame(void) {
+    TEST("A nested frame doesn't move messages under the outer one");
+    
+    window_t *win = create_window("Nested", 0, MAKERECT(0, 0, 10, 10), NULL, nested_proc, NULL);
+    repost_messages();
+    nested_idle_sends = 0;
+    
+    post_message(win, TEST_MESSAGE_BASE, 0, NULL);
+    post_idle_message(win, TEST_MESSAGE_BASE + 1, 0, NULL);
+    post_idle_message(win, TEST_MESSAGE_BASE + 2, 0, NULL);
+    for (int frame = 0; frame < 3; frame++) {
+        repost_messages();
+    }
+    ASSERT_EQUAL(nested_idle_sends, 1);
+    
+    destroy_window(win);
+    PASS();
+}
+
+static int hook_calls[4];
+
+static void counting_hook(window_t *win, uint32_t msg, uint32_t wparam, void *lparam, void *userdata) {
+    (void)win;
+    (void)wparam;
+    (void)lparam;
+    (void)userdata;
+    hook_calls[(msg - TEST_MESSAGE_BASE) & 3]++;
+}
+
+void test_hook_dispatch(void) {
+    TEST("Hooks run only for their message and go away with their owner");
+    
+    window_t *win = create_window("Hooks", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+    window_t *owner = create_window("Owner", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+    memset(hook_calls, 0, sizeof(hook_calls));
+    
+    // Many user messages share the hash buckets
+    for (int i = 0; i < 256; i++) {
+        register_window_hook(TEST_MESSAGE_BASE + i, counting_hook, owner);
+    }
+    register_window_hook(TEST_MESSAGE_BASE + 1, counting_hook, NULL);
+    send_message(win, TEST_MESSAGE_BASE, 0, NULL);
+    send_message(win, TEST_MESSAGE_BASE + 1, 0, NULL);
+    send_message(win, TEST_MESSAGE_BASE + 256, 0, NULL);
+    ASSERT_EQUAL(hook_calls[0], 1);
+    ASSERT_EQUAL(hook_calls[1], 2);
+    
+    deregister_window_hook(TEST_MESSAGE_BASE + 1, counting_hook, NULL);
+    send_message(win, TEST_MESSAGE_BASE + 1, 0, NULL);
+    ASSERT_EQUAL(hook_calls[1], 3);
+    
+    // Destroying the owner removes its hooks but keeps other owners'
+    register_window_hook(TEST_MESSAGE_BASE + 2, counting_hook, NULL);
+    destroy_window(owner);
+    send_message(win, TEST_MESSAGE_BASE, 0, NULL);
+    send_message(win, TEST_MESSAGE_BASE + 2, 0, NULL);
+    ASSERT_EQUAL(hook_calls[0], 1);
+    ASSERT_EQUAL(hook_calls[2], 1);
+    deregister_window_hook(TEST_MESSAGE_BASE + 2, counting_hook, NULL);
+    
+    destroy_window(win);
+    PASS();
+}
+
+void test_window_items(void) {
+    TEST("Controls are found by ID through the root's table");
+    
+    window_t *root = create_window("Items", 0, MAKERECT(0, 0, 100, 100), NULL, counting_proc, NULL);
+    window_t *panel = create_window("Panel", 0, MAKERECT(0, 0, 50, 50), root, counting_proc, NULL);
+    window_t *items[300];
+    for (int i = 0; i < 300; i++) {
+        windef_t def = { counting_proc, "", 1000 + i, 10, 10, 0 };
+        items[i] = create_window2(&def, MAKERECT(0, 0, 0, 0), i % 2 ? panel : root);
+    }
+    for (int i = 0; i < 300; i++) {
+        ASSERT_EQUAL(get_window_item(root, 1000 + i), items[i]);
+    }
+    ASSERT_EQUAL(get_window_item(panel, 1001), items[1]);
+    ASSERT_NULL(get_window_item(panel, 1000));
+    ASSERT_NULL(get_window_item(root, 999));
+    
+    // The first control created with an ID wins until it goes away
+    window_t *dup = create_window("", 0, MAKERECT(0, 0, 10, 10), panel, counting_proc, NULL);
+    dup->id = 1002;
+    ASSERT_EQUAL(get_window_item(root, 1002), items[2]);
+    ASSERT_EQUAL(get_window_item(panel, 1002), dup);
+    destroy_window(items[2]);
+    ASSERT_EQUAL(get_window_item(root, 1002), dup);
+    
+    // Renumbered controls are found under their new ID only
+    items[10]->id = 5;
+    ASSERT_EQUAL(get_window_item(root, 5), items[10]);
+    ASSERT_NULL(get_window_item(root, 1010));
+    
+    // Destroying a subtree drops its controls
+    destroy_window(panel);
+    ASSERT_NULL(get_window_item(root, 1001));
+    ASSERT_NULL(get_window_item(root, 1002));
+    ASSERT_EQUAL(get_window_item(root, 1298), items[298]);
+    
+    destroy_window(root);
+    PASS();
+}
+
+void test_window_handles(void) {
+    TEST("Handles go stale when their window is destroyed");
+    
+    window_t *root = create_window("Handles", 0, MAKERECT(0, 0, 100, 100), NULL, counting_proc, NULL);
+    window_t *child = create_window("Child", 0, MAKERECT(0, 0, 10, 10), root, counting_proc, NULL);
+    hwnd_t root_handle = get_window_handle(root);
+    hwnd_t child_handle = get_window_handle(child);
+    ASSERT_TRUE(root_handle != 0);
+    ASSERT_TRUE(child_handle != root_handle);
+    ASSERT_EQUAL(window_from_handle(root_handle), root);
+    ASSERT_EQUAL(window_from_handle(child_handle), child);
+    ASSERT_TRUE(is_window(child));
+    ASSERT_NULL(window_from_handle(0));
+    
+    // A reused slot gets a new generation
+    destroy_window(child);
+    ASSERT_NULL(window_from_handle(child_handle));
+    window_t *other = create_window("Other", 0, MAKERECT(0, 0, 10, 10), root, counting_proc, NULL);
+    ASSERT_NULL(window_from_handle(child_handle));
+    ASSERT_EQUAL(window_from_handle(get_window_handle(other)), other);
+    
+    // The table grows without invalidating live handles
+    window_t *many[200];
+    for (int i = 0; i < 200; i++) {
+        many[i] = create_window("", 0, MAKERECT(0, 0, 1, 1), root, counting_proc, NULL);
+    }
+    ASSERT_EQUAL(window_from_handle(root_handle), root);
+    ASSERT_EQUAL(window_from_handle(get_window_handle(many[0])), many[0]);
+    ASSERT_TRUE(is_window(many[199]));
+    
+    destroy_window(root);
+    ASSERT_NULL(window_from_handle(root_handle));
+    ASSERT_FALSE(is_window(root));
+    PASS();
+}
+
+void test_handle_generations(void) {
+    TEST("A slot out of generations never matches an old handle");
+    
+    window_t *root = create_window("Cycle", 0, MAKERECT(0, 0, 100, 100), NULL, counting_proc, NULL);
+    window_t *child = create_window("Child", 0, MAKERECT(0, 0, 10, 10), root, counting_proc, NULL);
+    hwnd_t first = get_window_handle(child);
+    // Destroy and re-create one control past every generation of its slot
+    for (int i = 0; i < 5000; i++) {
+        destroy_window(child);
+        child = create_window("Child", 0, MAKERECT(0, 0, 10, 10), root, counting_proc, NULL);
+        ASSERT_TRUE(get_window_handle(child) != first);
+        ASSERT_NULL(window_from_handle(first));
+        ASSERT_EQUAL(window_from_handle(get_window_handle(child)), child);
+    }
+    
+    destroy_window(root);
+    PASS();
+}
+
+void test_top_level_handle_cycles(void) {
+    TEST("A top-level window created and destroyed in a loop keeps a handle");
+    
+    window_t *win = create_window("Loop", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+    hwnd_t first = get_window_handle(win);
+    for (int i = 0; i < 10000; i++) {
+        destroy_window(win);
+        win = create_window("Loop", 0, MAKERECT(0, 0, 10, 10), NULL, counting_proc, NULL);
+        ASSERT_TRUE(get_window_handle(win) != 0);
+        ASSERT_EQUAL(window_from_handle(get_window_handle(win)), win);
+        ASSERT_TRUE(is_window(win));
+        ASSERT_NULL(window_from_handle(first));
+    }
+    destroy_window(win);
+    PASS();
+}
+
 int main(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
@@ -284,6 +713,18 @@ int main(int argc, char *argv[]) {
     test_event_details();
     test_parent_child_messages();
     test_clear_events();
+    test_many_window_ids();
+    test_idle_wait();
+    test_frame_scheduler();
+    test_message_lanes();
+    test_message_queue_growth();
+    test_waiting_idle_message();
+    test_nested_frame();
+    test_hook_dispatch();
+    test_window_items();
+    test_window_handles();
+    test_handle_generations();
+    test_top_level_handle_cycles();
     
     TEST_END();
 }
@@ -0,0 +1,102 @@
+// Window compositor
+// Top-level windows paint into offscreen surfaces only when they get a paint
+// message. Every frame is then drawn as one textured quad per window, back to
+// front, so moving a window repaints nothing and needs no visibility clipping.
+
+#include <SDL2/SDL.h>
+#include "gl_compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "user.h"
+#include "messages.h"
+#include "draw.h"
+#include "../kernel/software.h"
+
+// External references
+extern window_t *windows;
+
+// Forward declarations
+extern rect_t window_outer_rect(window_t const *win);
+extern rect_t get_opengl_rect(rect_t const *r);
+extern void set_render_target(rect_t const *r);
+extern void set_fullscreen(void);
+
+static struct {
+  bool enabled;
+  window_t *target;  // Window whose surface is bound
+} compositor = {0};
+
+// Compositing needs framebuffer objects, so the software backend ignores it
+void enable_compositing(bool enable) {
+  compositor.enabled = enable && !sw_enabled();
+}
+
+bool is_compositing(void) {
+  return compositor.enabled;
+}
+
+// Redirect drawing into the surface of win's root window, (re)allocating it
+// when the window size changed. A full repaint (non-client paint) clears it
+// first. Returns false if nothing was bound.
+bool begin_window_surface(window_t *win, bool repaint) {
+  if (!compositor.enabled || compositor.target) return false;
+  window_t *root = get_root_window(win);
+  rect_t r = window_outer_rect(root);
+  set_render_target(NULL);
+  rect_t size = get_opengl_rect(&r);
+  R_Framebuffer *fb = &root->top->surface;
+  bool fresh = false;
+  flush_sprites();
+  if (!fb->fbo || fb->color.width != size.w || fb->color.height != size.h) {
+    R_FramebufferDestroy(fb);
+    if (!R_FramebufferInit(fb, size.w, size.h)) return false;
+    fresh = true;
+  }
+  R_BindFramebuffer(fb->fbo);
+  set_render_target(&r);
+  if (fresh || repaint) {
+    R_ClearColor(0, 0, 0, 0);
+  }
+  if (fresh && !repaint) {
+    // A new surface is empty; paint the whole window again
+    post_message(root, kWindowMessageNonClientPaint, 0, NULL);
+    post_message(root, kWindowMessagePaint, 0, NULL);
+  }
+  compositor.target = root;
+  return true;
+}
+
+// Return to drawing into the window
+void end_window_surface(void) {
+  if (!compositor.target) return;
+  flush_sprites();
+  R_BindFramebuffer(0);
+  set_render_target(NULL);
+  compositor.target = NULL;
+}
+
+// Draw every visible top-level surface in z-order
+void composite_windows(void) {
+  if (!compositor.enabled) return;
+  end_window_surface();
+  R_ClearColor(0, 0, 0, 1);
+  set_fullscreen();
+  for (window_t *win = windows; win; win = win->next) {
+    if (!win->visible || !win->top->surface.fbo) continue;
+    rect_t r = window_outer_rect(win);
+    draw_surface(win->top->surface.color.id, r.x, r.y, r.w, r.h);
+  }
+}
+
+// Release a window's surface
+void free_window_surface(window_t *win) {
+  if (compositor.target == win) {
+    end_window_surface();
+  }
+  if (win->top->surface.fbo) {
+    R_FramebufferDestroy(&win->top->surface);
+  }
+}
@@ -36,7 +36,9 @@ uint32_t show_dialog(char const *title,
   window_t *dlg = create_window("Things", flags, frame, NULL, proc, param);
   enable_window(parent, false);
   show_window(dlg, true);
-  while (running && is_window(dlg)) {
+  // A later window may reuse the address, but never the handle
+  hwnd_t handle = get_window_handle(dlg);
+  while (running && window_from_handle(handle)) {
     while (get_message(&event)) {
       dispatch_message(&event);
     }
@@ -31,16 +31,30 @@ void set_fullscreen(void) {
   set_projection(0, 0, w, h);
 }
 
+// Screen rect covered by the bound compositor surface; empty for the window
+static rect_t render_target;
+
+void set_render_target(rect_t const *r) {
+  render_target = r ? *r : (rect_t){0};
+}
+
 rect_t get_opengl_rect(rect_t const *r) {
   int w, h;
-  SDL_GL_GetDrawableSize(window, &w, &h);
+  // Cached by the renderer; only ask SDL when it hasn't been set yet
+  R_GetDrawableSize(&w, &h);
+  if (w == 0 || h == 0) {
+    SDL_GL_GetDrawableSize(window, &w, &h);
+  }
 
   float scale_x = (float)w / MAX(1,ui_get_system_metrics(kSystemMetricScreenWidth));
   float scale_y = (float)h / MAX(1,ui_get_system_metrics(kSystemMetricScreenHeight));
+  rect_t const *t = render_target.w ? &render_target : &(rect_t){
+    0, 0, ui_get_system_metrics(kSystemMetricScreenWidth), ui_get_system_metrics(kSystemMetricScreenHeight)
+  };
   
   return (rect_t){
-    (int)(r->x * scale_x),
-    (int)((ui_get_system_metrics(kSystemMetricScreenHeight) - r->y - r->h) * scale_y), // flip Y
+    (int)((r->x - t->x) * scale_x),
+    (int)((t->y + t->h - r->y - r->h) * scale_y), // flip Y
     (int)(r->w * scale_x),
     (int)(r->h * scale_y)
   };
@@ -150,75 +164,28 @@ void draw_statusbar(window_t *win, const char *text) {
 
 // Set OpenGL viewport for window
 void set_viewport(rect_t const *frame) {
-  int w, h;
-  SDL_GL_GetDrawableSize(window, &w, &h);
-  
   rect_t ogl_rect = get_opengl_rect(frame);
   
-  glEnable(GL_SCISSOR_TEST);
-  glViewport(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
-  glScissor(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
+  set_sprite_viewport(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
+  set_sprite_scissor(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
 }
 
 void set_clip_rect(window_t const *win, rect_t const *r) {
   rect_t ogl_rect = get_opengl_rect(win?&(rect_t){
     win->frame.x + r->x, win->frame.y + r->y, r->w, r->h
   }:r);
-  glEnable(GL_SCISSOR_TEST);
-  glScissor(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
-}
-
-// Paint window to stencil buffer
-void paint_window_stencil(window_t const *w) {
-  int p = 1;
-  int t = titlebar_height(w);
-  int s = statusbar_height(w);
-  glStencilFunc(GL_ALWAYS, w->id, 0xFF);            // Always pass
-  glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE); // Replace stencil with window ID
-  draw_rect(1, w->frame.x-p, w->frame.y-t-p, w->frame.w+p*2, w->frame.h+t+s+p*2);
-}
-
-// Repaint window stencil buffer
-void repaint_stencil(void) {
-  set_fullscreen();
-  
-  glEnable(GL_STENCIL_TEST);
-  glClearStencil(0);
-  glClear(GL_STENCIL_BUFFER_BIT);
-  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-  for (window_t *w = windows; w; w = w->next) {
-    if (!w->visible)
-      continue;
-    send_message(w, kWindowMessagePaintStencil, 0, NULL);
-  }
-  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-  glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-}
-
-// Set stencil test to render for specific window
-void ui_set_stencil_for_window(uint32_t window_id) {
-  glStencilFunc(GL_EQUAL, window_id, 0xFF);
-}
-
-// Set stencil test to render for root window
-void ui_set_stencil_for_root_window(uint32_t window_id) {
-  glStencilFunc(GL_EQUAL, window_id, 0xFF);
+  set_sprite_scissor(ogl_rect.x, ogl_rect.y, ogl_rect.w, ogl_rect.h);
 }
 
 // Fill a rectangle with a solid color
 void fill_rect(int color, int x, int y, int w, int h) {
   extern bool running;
-  extern GLuint ui_white_texture;
   
   // Skip drawing if graphics aren't initialized (e.g., in tests)
   if (!running) return;
   
-  // Update the white texture with the desired color
-  glBindTexture(GL_TEXTURE_2D, ui_white_texture);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &color);
-  
-  // Draw a rectangle using the texture
-  draw_rect_ex(ui_white_texture, x, y, w, h, false, 1);
+  // Color goes into the vertices so consecutive fills share one draw call
+  push_solid_rect(x, y, w, h, (uint32_t)color);
 }
 
 void draw_icon8(int icon, int x, int y, uint32_t col) {
@@ -0,0 +1,130 @@
+// Window handles
+// A handle is a slot in the handle table plus the slot's generation when the
+// window got it. Destroying the window bumps the generation, so a stale handle
+// is rejected with one comparison even after the slot is reused. A slot that
+// runs out of generations is retired instead of wrapping around. The table
+// is kept until shutdown, so each slot cycles through its own generations.
+// Live slots are also chained by window address so raw pointers can be checked.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "user.h"
+
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATIONS (1u << (32 - HANDLE_INDEX_BITS))
+
+typedef struct {
+  window_t *win;        // NULL if free
+  uint32_t generation;  // Never 0, so no handle is 0
+  uint32_t next;        // Next free slot, or next live slot in the bucket; 1-based
+} handle_slot_t;
+
+static struct {
+  handle_slot_t *slots;
+  uint32_t *buckets;    // First live slot per address hash; 1-based
+  uint32_t capacity;    // Power of two, also the bucket count
+  uint32_t used;        // Slots handed out at least once
+  uint32_t count;       // Live windows
+  uint32_t free_list;   // 1-based
+} handles = {0};
+
+static uint32_t pointer_bucket(window_t const *win) {
+  uintptr_t p = (uintptr_t)win;
+  p ^= p >> 16;
+  return (uint32_t)(p * 0x9E3779B1u) & (handles.capacity - 1);
+}
+
+static bool grow_handles(void) {
+  uint32_t capacity = MAX(64, handles.capacity * 2);
+  if (capacity > HANDLE_INDEX_MASK + 1) return false;
+  handle_slot_t *slots = realloc(handles.slots, capacity * sizeof(handle_slot_t));
+  if (!slots) return false;
+  handles.slots = slots;
+  uint32_t *buckets = calloc(capacity, sizeof(uint32_t));
+  if (!buckets) return false;
+  free(handles.buckets);
+  handles.buckets = buckets;
+  handles.capacity = capacity;
+  // Slots keep their indices; only the address chains are rebuilt
+  for (uint32_t i = 0; i < handles.used; i++) {
+    if (!slots[i].win) continue;
+    uint32_t b = pointer_bucket(slots[i].win);
+    slots[i].next = buckets[b];
+    buckets[b] = i + 1;
+  }
+  return true;
+}
+
+// Give a new window a handle
+hwnd_t alloc_window_handle(window_t *win) {
+  uint32_t index;
+  if (handles.free_list) {
+    index = handles.free_list - 1;
+    handles.free_list = handles.slots[index].next;
+  } else {
+    if (handles.used == handles.capacity && !grow_handles()) return 0;
+    // No handle was ever issued for a fresh slot, so nothing stale can match
+    index = handles.used++;
+    handles.slots[index].generation = 1;
+  }
+  handle_slot_t *slot = &handles.slots[index];
+  uint32_t b = pointer_bucket(win);
+  slot->win = win;
+  slot->next = handles.buckets[b];
+  handles.buckets[b] = index + 1;
+  handles.count++;
+  return (slot->generation << HANDLE_INDEX_BITS) | index;
+}
+
+// Invalidate a window's handle
+void free_window_handle(window_t *win) {
+  uint32_t index = win->handle & HANDLE_INDEX_MASK;
+  if (!win->handle || index >= handles.used || handles.slots[index].win != win) return;
+  for (uint32_t *link = &handles.buckets[pointer_bucket(win)]; *link; link = &handles.slots[*link - 1].next) {
+    if (*link == index + 1) {
+      *link = handles.slots[index].next;
+      break;
+    }
+  }
+  handle_slot_t *slot = &handles.slots[index];
+  slot->win = NULL;
+  if (slot->generation + 1 < HANDLE_GENERATIONS) {
+    slot->generation++;
+    slot->next = handles.free_list;
+    handles.free_list = index + 1;
+  }
+  win->handle = 0;
+  handles.count--;
+}
+
+// Free the handle table (called on shutdown, once no windows are left)
+void cleanup_window_handles(void) {
+  if (handles.count) return;
+  free(handles.slots);
+  free(handles.buckets);
+  memset(&handles, 0, sizeof(handles));
+}
+
+// Window a handle refers to, or NULL if it was destroyed
+window_t *window_from_handle(hwnd_t handle) {
+  uint32_t index = handle & HANDLE_INDEX_MASK;
+  if (index >= handles.used) return NULL;
+  handle_slot_t const *slot = &handles.slots[index];
+  return slot->generation == handle >> HANDLE_INDEX_BITS ? slot->win : NULL;
+}
+
+hwnd_t get_window_handle(window_t const *win) {
+  return win ? win->handle : 0;
+}
+
+// Check if pointer is a live window, top-level or child
+bool is_window(window_t *win) {
+  if (!win || !handles.capacity) return false;
+  for (uint32_t i = handles.buckets[pointer_bucket(win)]; i; i = handles.slots[i - 1].next) {
+    if (handles.slots[i - 1].win == win) return true;
+  }
+  return false;
+}
@@ -0,0 +1,231 @@
+// Hit testing
+// Top-level windows and the children of each window are bucketed into a
+// uniform grid of cells, in z-order, so a point only checks the windows
+// overlapping its cell. Grids are rebuilt lazily after windows move, resize,
+// show, hide, restack, appear or go away.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "user.h"
+
+#define HIT_CELL_SIZE 32
+#define HIT_MAX_CELLS 4096
+
+typedef struct {
+  window_t *win;
+  rect_t rect;
+  bool covered;  // A later window overlaps it in some cell
+} hit_entry_t;
+
+struct hit_grid_s {
+  bool stale;
+  int x, y;            // Origin of cell 0
+  int cols, rows;
+  int cell_size;
+  int num_entries;
+  int last;            // Entry of the previous hit, or -1
+  hit_entry_t *entries;
+  int *cells;          // First index in items of each cell, plus one past the end
+  int *items;          // Entry indices, back to front within a cell
+};
+
+// Top-level windows; their hit rects include the title and status bars
+static hit_grid_t top_level = { .stale = true, .last = -1 };
+
+// External references
+extern window_t *windows;
+
+// Forward declarations
+extern int titlebar_height(window_t const *win);
+extern int statusbar_height(window_t const *win);
+
+#define CONTAINS(x, y, r) \
+((r).x <= (x) && (r).y <= (y) && (r).x + (r).w > (x) && (r).y + (r).h > (y))
+
+static void clear_grid(hit_grid_t *grid) {
+  free(grid->entries);
+  free(grid->cells);
+  free(grid->items);
+  grid->entries = NULL;
+  grid->cells = NULL;
+  grid->items = NULL;
+  grid->num_entries = 0;
+  grid->cols = grid->rows = 0;
+  grid->last = -1;
+}
+
+// Cell range covered by r, clamped to the grid
+static void cell_span(hit_grid_t const *grid, rect_t const *r, int span[4]) {
+  span[0] = MAX(0, (r->x - grid->x) / grid->cell_size);
+  span[1] = MAX(0, (r->y - grid->y) / grid->cell_size);
+  span[2] = MIN(grid->cols - 1, (r->x + r->w - 1 - grid->x) / grid->cell_size);
+  span[3] = MIN(grid->rows - 1, (r->y + r->h - 1 - grid->y) / grid->cell_size);
+}
+
+static bool overlap(rect_t const *a, rect_t const *b) {
+  return a->x < b->x + b->w && b->x < a->x + a->w &&
+         a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+// Bucket the entries already in grid->entries
+static void build_cells(hit_grid_t *grid) {
+  if (grid->num_entries == 0) return;
+  int x1 = INT32_MAX, y1 = INT32_MAX, x2 = INT32_MIN, y2 = INT32_MIN;
+  for (int i = 0; i < grid->num_entries; i++) {
+    rect_t const *r = &grid->entries[i].rect;
+    x1 = MIN(x1, r->x);
+    y1 = MIN(y1, r->y);
+    x2 = MAX(x2, r->x + r->w);
+    y2 = MAX(y2, r->y + r->h);
+  }
+  // Large or sparse layouts get bigger cells rather than more of them
+  grid->cell_size = HIT_CELL_SIZE;
+  for (;;) {
+    grid->cols = (x2 - x1 + grid->cell_size - 1) / grid->cell_size;
+    grid->rows = (y2 - y1 + grid->cell_size - 1) / grid->cell_size;
+    if ((long)grid->cols * grid->rows <= HIT_MAX_CELLS) break;
+    grid->cell_size *= 2;
+  }
+  grid->x = x1;
+  grid->y = y1;
+  int num_cells = grid->cols * grid->rows;
+  grid->cells = calloc(num_cells + 1, sizeof(int));
+  if (!grid->cells) {
+    clear_grid(grid);
+    return;
+  }
+  // Count per cell, turn counts into offsets, then fill in entry order
+  int total = 0, span[4];
+  for (int i = 0; i < grid->num_entries; i++) {
+    cell_span(grid, &grid->entries[i].rect, span);
+    for (int cy = span[1]; cy <= span[3]; cy++) {
+      for (int cx = span[0]; cx <= span[2]; cx++) {
+        grid->cells[cy * grid->cols + cx + 1]++;
+        total++;
+      }
+    }
+  }
+  for (int c = 0; c < num_cells; c++) {
+    grid->cells[c + 1] += grid->cells[c];
+  }
+  grid->items = malloc(MAX(1, total) * sizeof(int));
+  int *fill = malloc(num_cells * sizeof(int));
+  if (!grid->items || !fill) {
+    free(fill);
+    clear_grid(grid);
+    return;
+  }
+  memcpy(fill, grid->cells, num_cells * sizeof(int));
+  for (int i = 0; i < grid->num_entries; i++) {
+    hit_entry_t *e = &grid->entries[i];
+    cell_span(grid, &e->rect, span);
+    for (int cy = span[1]; cy <= span[3]; cy++) {
+      for (int cx = span[0]; cx <= span[2]; cx++) {
+        int c = cy * grid->cols + cx;
+        // Anything sharing a cell with a later window may be hidden by it
+        for (int k = grid->cells[c]; k < fill[c]; k++) {
+          hit_entry_t *below = &grid->entries[grid->items[k]];
+          if (!below->covered && overlap(&below->rect, &e->rect)) {
+            below->covered = true;
+          }
+        }
+        grid->items[fill[c]++] = i;
+      }
+    }
+  }
+  free(fill);
+}
+
+// Index a list of sibling windows, back to front. Top-level windows are
+// indexed by the area they accept clicks in when shown; children always are.
+static void build_grid(hit_grid_t *grid, window_t *list, bool top) {
+  clear_grid(grid);
+  grid->stale = false;
+  int count = 0;
+  for (window_t *w = list; w; w = w->next) count++;
+  if (count == 0) return;
+  if (!(grid->entries = calloc(count, sizeof(hit_entry_t)))) return;
+  for (window_t *w = list; w; w = w->next) {
+    rect_t r = w->frame;
+    if (top) {
+      if (!w->visible) continue;
+      int t = titlebar_height(w);
+      r.y -= t;
+      r.h += t + statusbar_height(w);
+    }
+    if (r.w <= 0 || r.h <= 0) continue;
+    grid->entries[grid->num_entries++] = (hit_entry_t){ w, r, false };
+  }
+  build_cells(grid);
+}
+
+// Topmost window under (x, y) that accepts the hit. The previous hit is
+// tried first: if nothing was stacked over it, it still wins while the
+// point stays inside it.
+static window_t *query_grid(hit_grid_t *grid, int x, int y, bool top) {
+  if (grid->last >= 0) {
+    hit_entry_t const *e = &grid->entries[grid->last];
+    if (!e->covered && CONTAINS(x, y, e->rect) && (top || !e->win->notabstop)) {
+      return e->win;
+    }
+  }
+  if (!grid->cells || x < grid->x || y < grid->y) return NULL;
+  int cx = (x - grid->x) / grid->cell_size;
+  int cy = (y - grid->y) / grid->cell_size;
+  if (cx >= grid->cols || cy >= grid->rows) return NULL;
+  int c = cy * grid->cols + cx;
+  for (int k = grid->cells[c + 1] - 1; k >= grid->cells[c]; k--) {
+    hit_entry_t const *e = &grid->entries[grid->items[k]];
+    if (CONTAINS(x, y, e->rect) && (top || !e->win->notabstop)) {
+      grid->last = grid->items[k];
+      return e->win;
+    }
+  }
+  return NULL;
+}
+
+// Mark the index holding win out of date
+void invalidate_hit_test(window_t *win) {
+  if (!win->parent) {
+    top_level.stale = true;
+  } else if (win->parent->cold->hit_grid) {
+    win->parent->cold->hit_grid->stale = true;
+  }
+}
+
+// Topmost visible top-level window at screen coordinates
+window_t *hit_test_top_level(int x, int y) {
+  if (top_level.stale) {
+    build_grid(&top_level, windows, true);
+  }
+  return query_grid(&top_level, x, y, true);
+}
+
+// Topmost child of win at client coordinates that accepts hits
+window_t *hit_test_children(window_t *win, int x, int y) {
+  if (!win->children) return NULL;
+  if (!win->cold->hit_grid) {
+    if (!(win->cold->hit_grid = calloc(1, sizeof(hit_grid_t)))) return NULL;
+    win->cold->hit_grid->stale = true;
+  }
+  if (win->cold->hit_grid->stale) {
+    build_grid(win->cold->hit_grid, win->children, false);
+  }
+  return query_grid(win->cold->hit_grid, x, y, false);
+}
+
+// Release a window's child index, and the top-level one with the last window
+void free_hit_grid(window_t *win) {
+  if (win->cold->hit_grid) {
+    clear_grid(win->cold->hit_grid);
+    free(win->cold->hit_grid);
+    win->cold->hit_grid = NULL;
+  }
+  invalidate_hit_test(win);
+  if (!windows) {
+    clear_grid(&top_level);
+    top_level.stale = true;
+  }
+}
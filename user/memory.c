@@ -0,0 +1,200 @@
+// Window memory
+// window_t and control state come from size-class pools carved out of 64 KB
+// slabs, so destroying and re-creating windows reuses the same blocks. The
+// descendants of a WINDOW_ARENA window instead bump-allocate from its arena,
+// which is reset when its children are cleared and freed with it.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "user.h"
+#include "messages.h"
+
+#define POOL_MIN_SHIFT 5                  // 32-byte blocks
+#define POOL_CLASSES 10                   // Up to 16 KB blocks
+#define POOL_SLAB_SIZE (64 * 1024)
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// Every block starts with its kind: a pool class, an arena or the heap
+enum { kBlockArena = POOL_CLASSES, kBlockHeap };
+
+typedef struct {
+  uint32_t kind;
+  uint32_t pad[3];  // Keeps blocks 16-byte aligned
+} block_header_t;
+
+typedef struct free_block_s {
+  struct free_block_s *next;
+} free_block_t;
+
+typedef struct slab_s {
+  struct slab_s *next;
+} slab_t;
+
+static struct {
+  free_block_t *free[POOL_CLASSES];
+  slab_t *slabs;
+} pools = {0};
+
+typedef struct arena_chunk_s {
+  struct arena_chunk_s *next;
+  size_t size;  // Usable bytes after the chunk header
+  size_t used;
+} arena_chunk_t;
+
+struct window_arena_s {
+  arena_chunk_t *chunks;   // In the order they were filled
+  arena_chunk_t *current;  // Chunks before it are full
+};
+
+#define ALIGN16(n) (((n) + 15) & ~(size_t)15)
+
+static int pool_class(size_t size) {
+  for (int c = 0; c < POOL_CLASSES; c++) {
+    if (size <= (size_t)1 << (c + POOL_MIN_SHIFT)) return c;
+  }
+  return -1;
+}
+
+// Split a new slab into blocks of one class
+static bool refill_pool(int c) {
+  slab_t *slab = malloc(POOL_SLAB_SIZE);
+  if (!slab) return false;
+  slab->next = pools.slabs;
+  pools.slabs = slab;
+  size_t block = (size_t)1 << (c + POOL_MIN_SHIFT);
+  char *p = (char *)slab + ALIGN16(sizeof(slab_t));
+  char *end = (char *)slab + POOL_SLAB_SIZE;
+  for (; p + block <= end; p += block) {
+    free_block_t *b = (free_block_t *)p;
+    b->next = pools.free[c];
+    pools.free[c] = b;
+  }
+  return true;
+}
+
+static block_header_t *pool_alloc(size_t size) {
+  int c = pool_class(size);
+  if (c < 0) {
+    block_header_t *h = malloc(size);
+    if (h) h->kind = kBlockHeap;
+    return h;
+  }
+  if (!pools.free[c] && !refill_pool(c)) return NULL;
+  block_header_t *h = (block_header_t *)pools.free[c];
+  pools.free[c] = pools.free[c]->next;
+  h->kind = c;
+  return h;
+}
+
+static block_header_t *arena_alloc(window_arena_t *arena, size_t size) {
+  size = ALIGN16(size);
+  arena_chunk_t *chunk = arena->current, *prev = NULL;
+  while (chunk && chunk->used + size > chunk->size) {
+    prev = chunk;
+    chunk = chunk->next;
+  }
+  if (!chunk) {
+    size_t usable = MAX(ARENA_CHUNK_SIZE, size);
+    if (!(chunk = malloc(ALIGN16(sizeof(arena_chunk_t)) + usable))) return NULL;
+    chunk->size = usable;
+    chunk->used = 0;
+    chunk->next = NULL;
+    if (prev) prev->next = chunk;
+    else arena->chunks = chunk;
+  }
+  arena->current = chunk;
+  block_header_t *h = (block_header_t *)((char *)chunk + ALIGN16(sizeof(arena_chunk_t)) + chunk->used);
+  chunk->used += size;
+  h->kind = kBlockArena;
+  return h;
+}
+
+// Arena of a WINDOW_ARENA top-level window, created on first use
+static window_arena_t *root_arena(window_t *root) {
+  if (!(root->flags & WINDOW_ARENA)) return NULL;
+  if (!root->top->arena) root->top->arena = calloc(1, sizeof(window_arena_t));
+  return root->top->arena;
+}
+
+void free_window(window_t *win);
+
+static void *alloc_block(window_arena_t *arena, size_t size) {
+  size += sizeof(block_header_t);
+  block_header_t *h = arena ? arena_alloc(arena, size) : pool_alloc(size);
+  if (!h) return NULL;
+  memset(h + 1, 0, size - sizeof(block_header_t));
+  return h + 1;
+}
+
+// Allocate zeroed control state owned by win. Descendants of an arena window
+// use the arena; the window itself and everything else use the pools.
+void *alloc_window_memory(window_t *win, size_t size) {
+  return alloc_block(win && win->parent ? root_arena(get_root_window(win)) : NULL, size);
+}
+
+// Allocate a zeroed window to be created under parent. The hot and cold
+// records each fill a 128-byte block, so siblings pack densely in slabs.
+window_t *alloc_window(window_t *parent) {
+  window_arena_t *arena = parent ? root_arena(get_root_window(parent)) : NULL;
+  window_t *win = alloc_block(arena, sizeof(window_t));
+  if (!win) return NULL;
+  win->cold = alloc_block(arena, sizeof(window_cold_t));
+  win->top = parent ? NULL : alloc_block(NULL, sizeof(window_top_t));
+  if (!win->cold || (!parent && !win->top)) {
+    free_window(win);
+    return NULL;
+  }
+  return win;
+}
+
+// Return memory to its pool. Arena memory waits for the arena to be reset.
+void free_window_memory(void *ptr) {
+  if (!ptr) return;
+  block_header_t *h = (block_header_t *)ptr - 1;
+  uint32_t kind = h->kind;
+  if (kind < POOL_CLASSES) {
+    free_block_t *b = (free_block_t *)h;
+    b->next = pools.free[kind];
+    pools.free[kind] = b;
+  } else if (kind == kBlockHeap) {
+    free(h);
+  }
+}
+
+void free_window(window_t *win) {
+  free_window_memory(win->top);
+  free_window_memory(win->cold);
+  free_window_memory(win);
+}
+
+// Reuse a root's arena once its children are gone, or free it with the root
+void release_window_arena(window_t *root, bool keep) {
+  window_arena_t *arena = root->top ? root->top->arena : NULL;
+  if (!arena) return;
+  if (keep) {
+    for (arena_chunk_t *c = arena->chunks; c; c = c->next) {
+      c->used = 0;
+    }
+    arena->current = arena->chunks;
+    return;
+  }
+  while (arena->chunks) {
+    arena_chunk_t *next = arena->chunks->next;
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+  free(arena);
+  root->top->arena = NULL;
+}
+
+// Free every slab (called on shutdown, once no windows are left)
+void cleanup_window_pools(void) {
+  while (pools.slabs) {
+    slab_t *next = pools.slabs->next;
+    free(pools.slabs);
+    pools.slabs = next;
+  }
+  memset(&pools, 0, sizeof(pools));
+}
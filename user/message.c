@@ -12,6 +12,16 @@
 #include "messages.h"
 #include "draw.h"
 #include "gl_compat.h"
+#include "../kernel/software.h"
+
+// Priority lanes; each frame runs them in this order
+typedef enum {
+  kLaneInput,    // Messages caused by input, so it is never kept waiting
+  kLaneNormal,
+  kLanePaint,    // After the state changes that caused them
+  kLaneIdle,     // Only when no other lane has work
+  kNumLanes
+} msg_lane_t;
 
 // Message queue structure
 typedef struct {
@@ -19,174 +29,428 @@ typedef struct {
   uint32_t msg;
   uint32_t wparam;
   void *lparam;
+  msg_lane_t lane;
 } msg_t;
 
+// A window's queued message, linked from window_t::pending so duplicates and
+// a destroyed window's messages are found without scanning the queue
+struct pending_msg_s {
+  uint32_t msg;
+  uint32_t seq;                // Queue position
+  struct pending_msg_s *next;
+};
+
+#define MESSAGE_QUEUE_INITIAL 256  // Slots; doubles when full
+
+// Array of messages in posting order; message seq lives in slot seq. Sent and
+// cancelled messages leave holes (no target) that are closed after each frame.
 static struct {
-  uint8_t read, write;
-  msg_t messages[0x100];
+  msg_t *messages;
+  uint32_t capacity;
+  uint32_t count;              // Slots in use, holes included
+  pending_msg_t *free_nodes;   // Recycled pending_msg_t
+  uint32_t lanes[kNumLanes];   // Queued messages per lane, not counting holes
+  message_queue_stats_t stats;
 } queue = {0};
 
-// Window hooks
+#define QUEUE_SLOT(seq) (&queue.messages[seq])
+
+// Window hooks. Each hook is linked into the list for its message and the
+// list for its userdata, so dispatch, removal and window cleanup only touch
+// the hooks involved.
+typedef struct hook_list_s hook_list_t;
+
 typedef struct winhook_s {
   winhook_func_t func;
   uint32_t msg;
   void *userdata;
-  struct winhook_s *next;
+  struct winhook_s *prev, *next;              // Same message
+  struct winhook_s *prev_owned, *next_owned;  // Same userdata
+  hook_list_t *list, *owner;
 } winhook_t;
 
-static winhook_t *g_hooks = NULL;
+// Hooks sharing a key, chained in a hash bucket
+struct hook_list_s {
+  uintptr_t key;
+  winhook_t *first;
+  struct hook_list_s *next;
+};
+
+#define HOOK_BUCKETS 64
+
+static hook_list_t g_system_hooks[kWindowMessageUser];  // Indexed by message
+static hook_list_t *g_user_hooks[HOOK_BUCKETS];         // User messages by ID
+static hook_list_t *g_owned_hooks[HOOK_BUCKETS];        // By userdata
+static int g_user_hooks_count = 0;
+
+// Damaged root window being painted one region rect at a time
+static struct {
+  window_t *root;
+  region_t const *region;  // Client coordinates
+  rect_t rect;             // Rect of the current pass
+} g_damage = {0};
+
+// Top-level window whose visible region clips the paint in progress
+static window_t *g_clip_root = NULL;
 
 // External references
 extern window_t *windows;
 extern window_t *_focused;
 extern bool running;  // Set to true when graphics are initialized
+extern SDL_Window *window;
 
 // Forward declarations
 extern void draw_panel(window_t const *win);
 extern void draw_window_controls(window_t *win);
 extern void draw_statusbar(window_t *win, const char *text);
 extern void draw_bevel(rect_t const *r);
-extern void paint_window_stencil(window_t const *w);
-extern void repaint_stencil(void);
 extern void set_fullscreen(void);
 extern window_t *get_root_window(window_t *window);
+extern rect_t get_opengl_rect(rect_t const *r);
+extern bool begin_window_surface(window_t *win, bool repaint);
+extern void end_window_surface(void);
+extern void composite_windows(void);
+extern window_t *hit_test_children(window_t *win, int x, int y);
+
+static uint32_t hook_bucket(uintptr_t key) {
+  key ^= key >> 17;
+  key *= 0x9E3779B1u;
+  return (key >> 8) & (HOOK_BUCKETS - 1);
+}
+
+// Find the hook list for key in a hash table, optionally creating it
+static hook_list_t *find_hook_list(hook_list_t **table, uintptr_t key, bool create) {
+  hook_list_t **bucket = &table[hook_bucket(key)];
+  for (hook_list_t *l = *bucket; l; l = l->next) {
+    if (l->key == key) return l;
+  }
+  if (!create) return NULL;
+  hook_list_t *l = calloc(1, sizeof(hook_list_t));
+  if (!l) return NULL;
+  l->key = key;
+  l->next = *bucket;
+  *bucket = l;
+  return l;
+}
+
+// Free an empty hash table list
+static void release_hook_list(hook_list_t **table, hook_list_t *list) {
+  if (list->first) return;
+  for (hook_list_t **l = &table[hook_bucket(list->key)]; *l; l = &(*l)->next) {
+    if (*l == list) {
+      *l = list->next;
+      free(list);
+      return;
+    }
+  }
+}
+
+static hook_list_t *message_hooks(uint32_t msg, bool create) {
+  if (msg < kWindowMessageUser) return &g_system_hooks[msg];
+  return find_hook_list(g_user_hooks, msg, create);
+}
+
+static void unlink_hook(winhook_t *hook) {
+  if (hook->prev) hook->prev->next = hook->next;
+  else hook->list->first = hook->next;
+  if (hook->next) hook->next->prev = hook->prev;
+  if (hook->prev_owned) hook->prev_owned->next_owned = hook->next_owned;
+  else hook->owner->first = hook->next_owned;
+  if (hook->next_owned) hook->next_owned->prev_owned = hook->prev_owned;
+  if (hook->msg >= kWindowMessageUser) {
+    release_hook_list(g_user_hooks, hook->list);
+    g_user_hooks_count--;
+  }
+  release_hook_list(g_owned_hooks, hook->owner);
+  free(hook);
+}
 
 // Register a window hook
 void register_window_hook(uint32_t msg, winhook_func_t func, void *userdata) {
-  winhook_t *hook = malloc(sizeof(winhook_t));
+  winhook_t *hook = calloc(1, sizeof(winhook_t));
+  if (!hook) return;
+  hook->list = message_hooks(msg, true);
+  hook->owner = find_hook_list(g_owned_hooks, (uintptr_t)userdata, true);
+  if (!hook->list || !hook->owner) {
+    if (hook->list && msg >= kWindowMessageUser) release_hook_list(g_user_hooks, hook->list);
+    if (hook->owner) release_hook_list(g_owned_hooks, hook->owner);
+    free(hook);
+    return;
+  }
   hook->func = func;
   hook->msg = msg;
   hook->userdata = userdata;
-  hook->next = g_hooks;
-  g_hooks = hook;
+  if (msg >= kWindowMessageUser) g_user_hooks_count++;
+  // Newest hooks run first
+  if ((hook->next = hook->list->first)) hook->next->prev = hook;
+  hook->list->first = hook;
+  if ((hook->next_owned = hook->owner->first)) hook->next_owned->prev_owned = hook;
+  hook->owner->first = hook;
 }
 
 // De-register a window hook
 void deregister_window_hook(uint32_t msg, winhook_func_t func, void *userdata) {
-  if (!g_hooks) return;
-  while (g_hooks && msg == g_hooks->msg && func == g_hooks->func && userdata == g_hooks->userdata) {
-    winhook_t *h = g_hooks;
-    g_hooks = g_hooks->next;
-    free(h);
-  }
-  for (winhook_t *w=g_hooks?g_hooks->next:NULL,*p=g_hooks;w;w=w->next,p=p->next) {
-    if (msg == w->msg && func == w->func && userdata == w->userdata) {
-      winhook_t *h = w;
-      p->next = w->next;
-      free(h);
+  hook_list_t *list = message_hooks(msg, false);
+  for (winhook_t *h = list ? list->first : NULL, *next; h; h = next) {
+    next = h->next;
+    if (func == h->func && userdata == h->userdata) {
+      unlink_hook(h);  // May free an emptied list, but then next is NULL
     }
   }
 }
 
+// Unlink every hook of an owner; the list is freed with its last hook
+static void remove_owned_hooks(hook_list_t *owner) {
+  for (bool last = !owner; !last;) {
+    last = !owner->first->next_owned;
+    unlink_hook(owner->first);
+  }
+}
+
 // Remove window from hooks
 void remove_from_global_hooks(window_t *win) {
-  if (!g_hooks) return;
-  while (g_hooks && win == g_hooks->userdata) {
-    winhook_t *h = g_hooks;
-    g_hooks = g_hooks->next;
-    free(h);
-  }
-  for (winhook_t *w=g_hooks?g_hooks->next:NULL,*p=g_hooks;w;w=w->next,p=p->next) {
-    if (w->userdata == win) {
-      winhook_t *h = w;
-      p->next = w->next;
-      free(h);
-    }
-  }
+  remove_owned_hooks(find_hook_list(g_owned_hooks, (uintptr_t)win, false));
 }
 
 // Clean up all hooks (called on shutdown)
 void cleanup_all_hooks(void) {
-  while (g_hooks) {
-    winhook_t *next = g_hooks->next;
-    free(g_hooks);
-    g_hooks = next;
+  for (int i = 0; i < HOOK_BUCKETS; i++) {
+    while (g_owned_hooks[i]) {
+      remove_owned_hooks(g_owned_hooks[i]);
+    }
   }
-  g_hooks = NULL;  // Ensure it's NULL for idempotency
 }
 
 // Remove window from message queue
 void remove_from_global_queue(window_t *win) {
-  for (uint8_t w = queue.write, r = queue.read; r != w; r++) {
-    if (queue.messages[r].target == win) {
-      queue.messages[r].target = NULL;
+  while (win->cold->pending) {
+    pending_msg_t *p = win->cold->pending;
+    win->cold->pending = p->next;
+    queue.lanes[QUEUE_SLOT(p->seq)->lane]--;
+    QUEUE_SLOT(p->seq)->target = NULL;
+    p->next = queue.free_nodes;
+    queue.free_nodes = p;
+  }
+}
+
+// Release the queue storage (called on shutdown)
+void cleanup_message_queue(void) {
+  for (uint32_t seq = 0; seq < queue.count; seq++) {
+    msg_t *m = QUEUE_SLOT(seq);
+    if (m->target) remove_from_global_queue(m->target);
+  }
+  while (queue.free_nodes) {
+    pending_msg_t *next = queue.free_nodes->next;
+    free(queue.free_nodes);
+    queue.free_nodes = next;
+  }
+  free(queue.messages);
+  memset(&queue, 0, sizeof(queue));
+}
+
+message_queue_stats_t get_message_queue_stats(void) {
+  queue.stats.capacity = queue.capacity;
+  return queue.stats;
+}
+
+// Find the link pointing at win's pending msg, or at the list end
+static pending_msg_t **find_pending(window_t *win, uint32_t msg) {
+  pending_msg_t **link = &win->cold->pending;
+  while (*link && (*link)->msg != msg) link = &(*link)->next;
+  return link;
+}
+
+// Drop a queued message, leaving a hole that the reader skips
+static void cancel_message(uint32_t seq) {
+  msg_t *m = QUEUE_SLOT(seq);
+  if (!m->target) return;
+  pending_msg_t **link = find_pending(m->target, m->msg);
+  if (*link) {
+    pending_msg_t *p = *link;
+    *link = p->next;
+    p->next = queue.free_nodes;
+    queue.free_nodes = p;
+  }
+  queue.lanes[m->lane]--;
+  m->target = NULL;
+}
+
+// Double the array, keeping every message at its sequence number
+static bool grow_queue(void) {
+  uint32_t capacity = queue.capacity ? queue.capacity * 2 : MESSAGE_QUEUE_INITIAL;
+  msg_t *messages = realloc(queue.messages, capacity * sizeof(msg_t));
+  if (!messages) return false;
+  queue.messages = messages;
+  queue.capacity = capacity;
+  return true;
+}
+
+// Paint the damaged part of a root window. A single full-window rect is an
+// ordinary paint; otherwise each rect is a scissored pass. The first pass
+// runs the procedure and the rest replay its display list.
+static int paint_damage(window_t *win, uint32_t wparam, void *lparam) {
+  rect_t client = { 0, 0, win->frame.w, win->frame.h };
+  region_t region = win->top->damage;
+  region_init(&win->top->damage);
+  region_intersect_rect(&region, &client);
+  int value = 0;
+  if (region_contains_rect(&region, &client)) {
+    value = send_message(win, kWindowMessagePaint, wparam, lparam);
+  } else if (!region_is_empty(&region)) {
+    g_damage.root = win;
+    g_damage.region = &region;
+    for (int i = 0; i < region.count; i++) {
+      g_damage.rect = region.rects[i];
+      value = send_message(win, kWindowMessagePaint, wparam, lparam);
     }
+    g_damage.root = NULL;
+    g_damage.region = NULL;
+    // Undamaged children weren't recorded, so the list can't be replayed
+    win->dirty = true;
   }
+  region_free(&region);
+  return value;
+}
+
+// Clip drawing to the part of root not covered by other windows, and to the
+// damage rect being painted. Returns false if none of it is on screen.
+static bool begin_visible_clip(window_t *root) {
+  region_t const *visible = &root->top->visible_region;
+  set_sprite_clip(0, 0, 0, 0);
+  bool any = false;
+  for (int i = 0; i < visible->count; i++) {
+    rect_t r = visible->rects[i];
+    if (root == g_damage.root) {
+      rect_t const *d = &g_damage.rect;
+      int x1 = MAX(r.x, root->frame.x + d->x), y1 = MAX(r.y, root->frame.y + d->y);
+      int x2 = MIN(r.x + r.w, root->frame.x + d->x + d->w);
+      int y2 = MIN(r.y + r.h, root->frame.y + d->y + d->h);
+      if (x1 >= x2 || y1 >= y2) continue;
+      r = (rect_t){ x1, y1, x2 - x1, y2 - y1 };
+    }
+    rect_t clip = get_opengl_rect(&r);
+    add_sprite_clip(clip.x, clip.y, clip.w, clip.h);
+    any = true;
+  }
+  return any;
 }
 
 // Send message to window (synchronous)
 int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
   if (!win) return false;
+  if (msg == kWindowMessagePaint && running && !win->parent &&
+      !region_is_empty(&win->top->damage)) {
+    return paint_damage(win, wparam, lparam);
+  }
   rect_t const *frame = &win->frame;
   window_t *root = get_root_window(win);
   int value = 0;
   if (win) {
-    // Call registered hooks
-    for (winhook_t *hook = g_hooks; hook; hook = hook->next) {
-      if (msg == hook->msg) {
-        hook->func(win, msg, wparam, lparam, hook->userdata);
+    // When compositing, paints go to the root window's surface
+    bool surface = running &&
+      (msg == kWindowMessageNonClientPaint || msg == kWindowMessagePaint) &&
+      begin_window_surface(win, msg == kWindowMessageNonClientPaint);
+    // Otherwise they are clipped to the visible part of the root window,
+    // and fully covered windows skip painting
+    bool clip = running && !surface && !g_clip_root &&
+      (msg == kWindowMessageNonClientPaint || msg == kWindowMessagePaint);
+    if (clip) {
+      g_clip_root = root;
+      if (!begin_visible_clip(root) && root->visible) {
+        clear_sprite_clip();
+        g_clip_root = NULL;
+        return 0;
       }
     }
+    // Call registered hooks
+    hook_list_t *hooks = msg < kWindowMessageUser ? &g_system_hooks[msg] :
+      g_user_hooks_count ? find_hook_list(g_user_hooks, msg, false) : NULL;
+    for (winhook_t *hook = hooks ? hooks->first : NULL, *next; hook; hook = next) {
+      next = hook->next;
+      hook->func(win, msg, wparam, lparam, hook->userdata);
+    }
     // Handle special messages
     switch (msg) {
       case kWindowMessageNonClientPaint:
         // Skip OpenGL calls if graphics aren't initialized (e.g., in tests)
         if (running) {
-          ui_set_stencil_for_window(win->id);
           set_fullscreen();
           if (!(win->flags&WINDOW_TRANSPARENT)) {
             draw_panel(win);
           }
           if (!(win->flags&WINDOW_NOTITLE)) {
             draw_window_controls(win);
-            draw_text_small(win->title, frame->x+2, window_title_bar_y(win), -1);
+            draw_text_small(win->cold->title, frame->x+2, window_title_bar_y(win), -1);
           }
           if (win->flags&WINDOW_TOOLBAR) {
             int t = TOOLBAR_HEIGHT;
             rect_t rect = {win->frame.x+1, win->frame.y-t+1, win->frame.w-2, t-2};
             draw_bevel(&rect);
             fill_rect(COLOR_PANEL_BG, rect.x, rect.y, rect.w, rect.h);
-            for (uint32_t i = 0; i < win->num_toolbar_buttons; i++) {
-              toolbar_button_t const *but = &win->toolbar_buttons[i];
+            for (uint32_t i = 0; i < win->top->num_toolbar_buttons; i++) {
+              toolbar_button_t const *but = &win->top->toolbar_buttons[i];
               uint32_t col = but->active ? COLOR_TEXT_SUCCESS : COLOR_TEXT_NORMAL;
               draw_icon16(but->icon, rect.x + i * TB_SPACING + 2, rect.y + 2, COLOR_DARK_EDGE);
               draw_icon16(but->icon, rect.x + i * TB_SPACING + 1, rect.y + 1, col);
             }
           }
           if (win->flags&WINDOW_STATUSBAR) {
-            draw_statusbar(win, win->statusbar_text);
+            draw_statusbar(win, win->top->statusbar_text);
           }
         }
         break;
       case kWindowMessagePaint:
         // Skip OpenGL calls if graphics aren't initialized (e.g., in tests)
         if (running) {
-          ui_set_stencil_for_root_window(get_root_window(win)->id);
           set_viewport(&root->frame);
           set_projection(root->scroll[0],
                          root->scroll[1],
                          root->frame.w + root->scroll[0],
                          root->frame.h + root->scroll[1]);
+          // Damaged areas don't get a non-client paint to clear them
+          if (win == g_damage.root && !(win->flags & (WINDOW_TRANSPARENT|WINDOW_NOFILL))) {
+            fill_rect(COLOR_PANEL_BG, win->scroll[0], win->scroll[1], frame->w, frame->h);
+          }
         }
         break;
       case kToolBarMessageAddButtons:
-        win->num_toolbar_buttons = wparam;
-        win->toolbar_buttons = malloc(sizeof(toolbar_button_t)*wparam);
-        memcpy(win->toolbar_buttons, lparam, sizeof(toolbar_button_t)*wparam);
+        // Toolbars and status bars belong to top-level windows
+        if (!win->top) break;
+        win->top->num_toolbar_buttons = wparam;
+        win->top->toolbar_buttons = alloc_window_memory(win, sizeof(toolbar_button_t)*wparam);
+        memcpy(win->top->toolbar_buttons, lparam, sizeof(toolbar_button_t)*wparam);
         break;
       case kWindowMessageStatusBar:
-        if (lparam) {
-          strncpy(win->statusbar_text, (const char*)lparam, sizeof(win->statusbar_text) - 1);
-          win->statusbar_text[sizeof(win->statusbar_text) - 1] = '\0';
+        if (lparam && win->top) {
+          strncpy(win->top->statusbar_text, (const char*)lparam, sizeof(win->top->statusbar_text) - 1);
+          win->top->statusbar_text[sizeof(win->top->statusbar_text) - 1] = '\0';
           invalidate_window(win);
         }
         break;
     }
+    // Windows that weren't invalidated since their last paint replay it
+    // instead of running the procedure; others record a new display list
+    bool replay = msg == kWindowMessagePaint && running && win->display_list && !win->dirty;
+    bool record = msg == kWindowMessagePaint && running && !replay && !is_recording_display_list();
+    if (record) {
+      win->display_list = begin_display_list(win->display_list);
+    }
     // Call window procedure
-    if (!(value = win->proc(win, msg, wparam, lparam))) {
+    if (replay) {
+      replay_display_list(win->display_list);
+      value = true;
+    } else if (!(value = win->proc(win, msg, wparam, lparam))) {
       switch (msg) {
         case kWindowMessagePaint:
           for (window_t *sub = win->children; sub; sub = sub->next) {
+            // Children outside the damage keep their pixels; allow for
+            // the focus ring drawn around controls
+            if (win == g_damage.root &&
+                !region_intersects(g_damage.region, &(rect_t){
+                  sub->frame.x - win->scroll[0] - 2, sub->frame.y - win->scroll[1] - 2,
+                  sub->frame.w + 4, sub->frame.h + 4 })) {
+              continue;
+            }
             sub->proc(sub, kWindowMessagePaint, wparam, lparam);
           }
           break;
@@ -201,21 +465,13 @@ int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
             invalidate_window(win);
           }
           break;
-        case kWindowMessagePaintStencil:
-          paint_window_stencil(win);
-          break;
-        case kWindowMessageHitTest:
-          for (window_t *item = win->children; item; item = item->next) {
-            rect_t r = item->frame;
-            uint16_t x = LOWORD(wparam), y = HIWORD(wparam);
-            #define CONTAINS(x, y, x1, y1, w1, h1) \
-            ((x1) <= (x) && (y1) <= (y) && (x1) + (w1) > (x) && (y1) + (h1) > (y))
-            if (!item->notabstop && CONTAINS(x, y, r.x, r.y, r.w, r.h)) {
-              *(window_t **)lparam = item;
-            }
-            #undef CONTAINS
+        case kWindowMessageHitTest: {
+          window_t *item = hit_test_children(win, LOWORD(wparam), HIWORD(wparam));
+          if (item) {
+            *(window_t **)lparam = item;
           }
           break;
+        }
         case kWindowMessageNonClientLeftButtonUp:
           if (win->flags&WINDOW_TOOLBAR) {
             uint16_t x = LOWORD(wparam);
@@ -224,8 +480,8 @@ int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
             int _y = win->frame.y - TOOLBAR_HEIGHT + 2;
             #define CONTAINS(x, y, x1, y1, w1, h1) \
             ((x1) <= (x) && (y1) <= (y) && (x1) + (w1) > (x) && (y1) + (h1) > (y))
-            for (uint32_t i = 0; i < win->num_toolbar_buttons; i++) {
-              toolbar_button_t *but = &win->toolbar_buttons[i];
+            for (uint32_t i = 0; i < win->top->num_toolbar_buttons; i++) {
+              toolbar_button_t *but = &win->top->toolbar_buttons[i];
               if (CONTAINS(x, y, _x + i * TB_SPACING, _y, 16, 16)) {
                 send_message(win, kToolBarMessageButtonClick, but->ident, but);
               }
@@ -235,6 +491,10 @@ int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
           break;
       }
     }
+    if (record) {
+      end_display_list();
+      win->dirty = false;
+    }
     // Draw disabled overlay
     if (win->disabled && msg == kWindowMessagePaint) {
       uint32_t col = (COLOR_PANEL_BG & 0x00FFFFFF) | 0x80000000;
@@ -242,43 +502,187 @@ int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
       set_projection(0, 0, ui_get_system_metrics(kSystemMetricScreenWidth), ui_get_system_metrics(kSystemMetricScreenHeight));
       fill_rect(col, win->frame.x, win->frame.y, win->frame.w, win->frame.h);
     }
+    if (clip) {
+      clear_sprite_clip();
+      g_clip_root = NULL;
+    }
+    if (surface) {
+      end_window_surface();
+    }
   }
   return value;
 }
 
+// Lane of a posted message
+static msg_lane_t message_lane(uint32_t msg) {
+  switch (msg) {
+    case kWindowMessageNonClientPaint:
+    case kWindowMessagePaint:
+      return kLanePaint;
+    case kWindowMessageNonClientLeftButtonUp:
+    case kWindowMessageSetFocus:
+    case kWindowMessageKillFocus:
+    case kWindowMessageTextInput:
+    case kWindowMessageWheel:
+    case kWindowMessageMouseMove:
+    case kWindowMessageMouseLeave:
+    case kWindowMessageLeftButtonDown:
+    case kWindowMessageLeftButtonUp:
+    case kWindowMessageRightButtonDown:
+    case kWindowMessageRightButtonUp:
+    case kWindowMessageKeyDown:
+    case kWindowMessageKeyUp:
+    case kWindowMessageJoyButtonDown:
+    case kWindowMessageJoyButtonUp:
+    case kWindowMessageJoyAxisMotion:
+      return kLaneInput;
+    default:
+      return kLaneNormal;
+  }
+}
+
 // Post message to window queue (asynchronous)
-void post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
-  // Remove duplicate messages from queue
-  for (uint8_t w = queue.write, r = queue.read; r != w; r++) {
-    if (queue.messages[r].target == win &&
-        queue.messages[r].msg == msg)
-    {
-      queue.messages[r].target = NULL;
+static void queue_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam,
+                          msg_lane_t lane) {
+  if (!win) return;
+  if (queue.count == queue.capacity && !grow_queue()) {
+    queue.stats.dropped++;
+    return;
+  }
+  queue.stats.posted++;
+  // A newer duplicate replaces the queued message
+  pending_msg_t *p = *find_pending(win, msg);
+  if (p) {
+    queue.lanes[QUEUE_SLOT(p->seq)->lane]--;
+    QUEUE_SLOT(p->seq)->target = NULL;
+    queue.stats.coalesced++;
+  } else {
+    if ((p = queue.free_nodes)) {
+      queue.free_nodes = p->next;
+    } else if (!(p = malloc(sizeof(pending_msg_t)))) {
+      queue.stats.dropped++;
+      return;
     }
+    p->msg = msg;
+    p->next = win->cold->pending;
+    win->cold->pending = p;
   }
-  // Add new message
-  queue.messages[queue.write++] = (msg_t) {
+  p->seq = queue.count;
+  *QUEUE_SLOT(queue.count++) = (msg_t) {
     .target = win,
     .msg = msg,
     .wparam = wparam,
     .lparam = lparam,
+    .lane = lane,
   };
+  queue.lanes[lane]++;
+  queue.stats.high_water = MAX(queue.stats.high_water, queue.count);
+}
+
+void post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+  queue_message(win, msg, wparam, lparam, message_lane(msg));
+}
+
+// Post a message that runs only in a frame with nothing else to do
+void post_idle_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam) {
+  queue_message(win, msg, wparam, lparam, kLaneIdle);
+}
+
+// True while repost_messages has work, i.e. something was posted or invalidated
+bool has_pending_messages(void) {
+  for (int lane = 0; lane < kNumLanes; lane++) {
+    if (queue.lanes[lane]) return true;
+  }
+  return false;
+}
+
+// Send the messages queued in a lane, except those posted meanwhile
+static void send_lane(msg_lane_t lane) {
+  for (uint32_t seq = 0, end = queue.count; seq < end; seq++) {
+    msg_t m = *QUEUE_SLOT(seq);
+    if (m.target == NULL || m.lane != lane) continue;
+    cancel_message(seq);
+    send_message(m.target, m.msg, m.wparam, m.lparam);
+  }
 }
 
+// A full paint of a root window runs its children's procedures too, so
+// their own queued paints up to end are dropped
+static void drop_child_paints(window_t *root, uint32_t end) {
+  for (uint32_t seq = 0; seq < end; seq++) {
+    msg_t *m = QUEUE_SLOT(seq);
+    if (m->target && m->target->parent && m->msg == kWindowMessagePaint &&
+        get_root_window(m->target) == root) {
+      cancel_message(seq);
+    }
+  }
+}
+
+// Close the holes left by sent and cancelled messages, keeping the order, so
+// messages left waiting (idle ones, say) don't make the array grow. Only run
+// between frames: the loops of a frame walk sequence numbers they captured.
+static void compact_queue(void) {
+  uint32_t dst = 0;
+  for (uint32_t seq = 0; seq < queue.count; seq++) {
+    msg_t *m = QUEUE_SLOT(seq);
+    if (!m->target) continue;
+    if (seq != dst) {
+      (*find_pending(m->target, m->msg))->seq = dst;
+      *QUEUE_SLOT(dst) = *m;
+      m->target = NULL;
+    }
+    dst++;
+  }
+  queue.count = dst;
+}
+
+// Run one frame. Input messages go first, then other state messages, so
+// paints see their effects. Then queued paints are sent, at most one per
+// window: non-client paints, root windows, and children whose root wasn't
+// repainted in full. Idle messages run last if no other lane has work left.
+// Messages posted while painting wait for the next frame. The frame is only
+// presented if something was painted. A procedure may run a nested frame
+// (a modal dialog, say); the queue is only compacted by the outermost one.
 void repost_messages(void) {
-  for (uint8_t write = queue.write; queue.read != write;) {
-    msg_t *m = &queue.messages[queue.read++];
-    if (m->target == NULL) continue;
-    if (m->msg == kWindowMessageRefreshStencil) {
-      if (running) {
-        repaint_stencil();
+  static int depth = 0;
+  depth++;
+  bool changed = has_pending_messages();
+  send_lane(kLaneInput);
+  send_lane(kLaneNormal);
+  int painted = 0;
+  uint32_t end = queue.count;
+  for (int pass = 0; pass < 3; pass++) {
+    for (uint32_t seq = 0; seq < end; seq++) {
+      msg_t m = *QUEUE_SLOT(seq);
+      if (m.target == NULL || m.lane != kLanePaint) continue;
+      bool root = !m.target->parent;
+      if (pass == 0 ? m.msg != kWindowMessageNonClientPaint :
+          m.msg != kWindowMessagePaint || root != (pass == 1)) continue;
+      cancel_message(seq);
+      if (pass == 1) {
+        rect_t client = { 0, 0, m.target->frame.w, m.target->frame.h };
+        if (region_is_empty(&m.target->top->damage) ||
+            region_contains_rect(&m.target->top->damage, &client)) {
+          drop_child_paints(m.target, end);
+        }
       }
-      continue;
+      send_message(m.target, m.msg, m.wparam, m.lparam);
+      painted++;
     }
-    send_message(m->target, m->msg, m->wparam, m->lparam);
   }
-  if (running) {
-    glFlush();
-    // SDL_GL_SwapWindow(window);
+  if (!queue.lanes[kLaneInput] && !queue.lanes[kLaneNormal] && !queue.lanes[kLanePaint]) {
+    send_lane(kLaneIdle);
+  }
+  if (--depth == 0) {
+    compact_queue();
+  }
+  // Composited windows also need a new frame when they only moved
+  if (running && (painted || (changed && is_compositing()))) {
+    composite_windows();
+    flush_sprites();
+    R_EndFrame();
+    if (!sw_enabled()) {
+      SDL_GL_SwapWindow(window);
+    }
   }
 }
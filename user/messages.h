@@ -9,8 +9,6 @@ enum {
   kWindowMessageNonClientPaint,
   kWindowMessageNonClientLeftButtonUp,
   kWindowMessagePaint,
-  kWindowMessageRefreshStencil,
-  kWindowMessagePaintStencil,
   kWindowMessageSetFocus,
   kWindowMessageKillFocus,
   kWindowMessageHitTest,
@@ -76,6 +74,8 @@ enum {
 #define WINDOW_DIALOG       (1 << 10)
 #define WINDOW_TOOLBAR      (1 << 11)
 #define WINDOW_STATUSBAR    (1 << 12)
+#define WINDOW_POPUP        (1 << 13)
+#define WINDOW_ARENA        (1 << 14)  // Descendants allocate from an arena freed in bulk
 
 // Titlebar and toolbar dimensions
 #define TITLEBAR_HEIGHT   12
@@ -0,0 +1,213 @@
+// Banded rectangle regions, used for damage tracking and window visibility
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "user.h"
+#include "region.h"
+
+typedef struct {
+  int x1, x2;
+} span_t;
+
+void region_init(region_t *rgn) {
+  memset(rgn, 0, sizeof(*rgn));
+}
+
+void region_free(region_t *rgn) {
+  free(rgn->rects);
+  region_init(rgn);
+}
+
+void region_clear(region_t *rgn) {
+  rgn->count = 0;
+}
+
+bool region_is_empty(region_t const *rgn) {
+  return rgn->count == 0;
+}
+
+static bool push_rect(region_t *rgn, int x, int y, int w, int h) {
+  if (rgn->count == rgn->capacity) {
+    int capacity = MAX(8, rgn->capacity * 2);
+    rect_t *rects = realloc(rgn->rects, capacity * sizeof(rect_t));
+    if (!rects) return false;
+    rgn->rects = rects;
+    rgn->capacity = capacity;
+  }
+  rgn->rects[rgn->count++] = (rect_t){ x, y, w, h };
+  return true;
+}
+
+static int compare_ints(void const *a, void const *b) {
+  return *(int const *)a - *(int const *)b;
+}
+
+static int compare_spans(void const *a, void const *b) {
+  return ((span_t const *)a)->x1 - ((span_t const *)b)->x1;
+}
+
+// Append a band, growing the previous one instead when it touches this one
+// and covers the same spans
+static void push_band(region_t *out, int *prev_band, int y1, int y2,
+                      span_t const *spans, int count) {
+  if (count == 0) return;
+  int prev = *prev_band;
+  if (prev >= 0 && out->count - prev == count &&
+      out->rects[prev].y + out->rects[prev].h == y1) {
+    bool same = true;
+    for (int i = 0; i < count && same; i++) {
+      rect_t const *r = &out->rects[prev + i];
+      same = r->x == spans[i].x1 && r->x + r->w == spans[i].x2;
+    }
+    if (same) {
+      for (int i = 0; i < count; i++) {
+        out->rects[prev + i].h += y2 - y1;
+      }
+      return;
+    }
+  }
+  *prev_band = out->count;
+  for (int i = 0; i < count; i++) {
+    push_rect(out, spans[i].x1, y1, spans[i].x2 - spans[i].x1, y2 - y1);
+  }
+}
+
+void region_union_rect(region_t *rgn, rect_t const *r) {
+  if (r->w <= 0 || r->h <= 0) return;
+  if (region_contains_rect(rgn, r)) return;
+
+  // Every band edge of the result is an edge of the inputs
+  int num_edges = 0;
+  int *edges = malloc((rgn->count + 1) * 2 * sizeof(int));
+  span_t *spans = malloc((rgn->count + 1) * sizeof(span_t));
+  if (!edges || !spans) {
+    free(edges);
+    free(spans);
+    return;
+  }
+  for (int i = 0; i < rgn->count; i++) {
+    edges[num_edges++] = rgn->rects[i].y;
+    edges[num_edges++] = rgn->rects[i].y + rgn->rects[i].h;
+  }
+  edges[num_edges++] = r->y;
+  edges[num_edges++] = r->y + r->h;
+  qsort(edges, num_edges, sizeof(int), compare_ints);
+
+  region_t out;
+  region_init(&out);
+  int prev_band = -1;
+  for (int e = 0; e + 1 < num_edges; e++) {
+    int y1 = edges[e], y2 = edges[e + 1];
+    if (y1 == y2) continue;
+    // Input rects never straddle an edge, so overlapping one covers the band
+    int count = 0;
+    for (int i = 0; i < rgn->count; i++) {
+      rect_t const *s = &rgn->rects[i];
+      if (s->y <= y1 && s->y + s->h >= y2) {
+        spans[count++] = (span_t){ s->x, s->x + s->w };
+      }
+    }
+    if (r->y <= y1 && r->y + r->h >= y2) {
+      spans[count++] = (span_t){ r->x, r->x + r->w };
+    }
+    if (count == 0) {
+      prev_band = -1;
+      continue;
+    }
+    qsort(spans, count, sizeof(span_t), compare_spans);
+    int merged = 0;
+    for (int i = 1; i < count; i++) {
+      if (spans[i].x1 <= spans[merged].x2) {
+        spans[merged].x2 = MAX(spans[merged].x2, spans[i].x2);
+      } else {
+        spans[++merged] = spans[i];
+      }
+    }
+    push_band(&out, &prev_band, y1, y2, spans, merged + 1);
+  }
+  free(edges);
+  free(spans);
+  region_free(rgn);
+  *rgn = out;
+}
+
+void region_intersect_rect(region_t *rgn, rect_t const *r) {
+  region_t out;
+  region_init(&out);
+  for (int i = 0; i < rgn->count; i++) {
+    rect_t const *s = &rgn->rects[i];
+    int x1 = MAX(s->x, r->x), y1 = MAX(s->y, r->y);
+    int x2 = MIN(s->x + s->w, r->x + r->w), y2 = MIN(s->y + s->h, r->y + r->h);
+    if (x1 < x2 && y1 < y2) {
+      // Clipping can make bands equal, so rebuild to stay coalesced
+      region_union_rect(&out, &(rect_t){ x1, y1, x2 - x1, y2 - y1 });
+    }
+  }
+  region_free(rgn);
+  *rgn = out;
+}
+
+// Each rect loses the part inside r, leaving up to four pieces. They stay
+// banded when rebuilt, so only bands crossing r are split.
+void region_subtract_rect(region_t *rgn, rect_t const *r) {
+  if (r->w <= 0 || r->h <= 0 || !region_intersects(rgn, r)) return;
+  region_t out;
+  region_init(&out);
+  int rx2 = r->x + r->w, ry2 = r->y + r->h;
+  for (int i = 0; i < rgn->count; i++) {
+    rect_t const *s = &rgn->rects[i];
+    int sx2 = s->x + s->w, sy2 = s->y + s->h;
+    if (s->x >= rx2 || r->x >= sx2 || s->y >= ry2 || r->y >= sy2) {
+      region_union_rect(&out, s);
+      continue;
+    }
+    int y1 = MAX(s->y, r->y), y2 = MIN(sy2, ry2);
+    region_union_rect(&out, &(rect_t){ s->x, s->y, s->w, y1 - s->y });
+    region_union_rect(&out, &(rect_t){ s->x, y1, r->x - s->x, y2 - y1 });
+    region_union_rect(&out, &(rect_t){ rx2, y1, sx2 - rx2, y2 - y1 });
+    region_union_rect(&out, &(rect_t){ s->x, y2, s->w, sy2 - y2 });
+  }
+  region_free(rgn);
+  *rgn = out;
+}
+
+bool region_intersects(region_t const *rgn, rect_t const *r) {
+  for (int i = 0; i < rgn->count; i++) {
+    rect_t const *s = &rgn->rects[i];
+    if (s->x < r->x + r->w && r->x < s->x + s->w &&
+        s->y < r->y + r->h && r->y < s->y + s->h) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Rects are disjoint, so r is covered when the overlaps add up to its area
+bool region_contains_rect(region_t const *rgn, rect_t const *r) {
+  if (r->w <= 0 || r->h <= 0) return true;
+  long covered = 0;
+  for (int i = 0; i < rgn->count; i++) {
+    rect_t const *s = &rgn->rects[i];
+    int w = MIN(s->x + s->w, r->x + r->w) - MAX(s->x, r->x);
+    int h = MIN(s->y + s->h, r->y + r->h) - MAX(s->y, r->y);
+    if (w > 0 && h > 0) {
+      covered += (long)w * h;
+    }
+  }
+  return covered == (long)r->w * r->h;
+}
+
+rect_t region_bounds(region_t const *rgn) {
+  if (rgn->count == 0) return (rect_t){0};
+  int x1 = rgn->rects[0].x, y1 = rgn->rects[0].y;
+  int x2 = x1 + rgn->rects[0].w, y2 = y1 + rgn->rects[0].h;
+  for (int i = 1; i < rgn->count; i++) {
+    rect_t const *s = &rgn->rects[i];
+    x1 = MIN(x1, s->x);
+    y1 = MIN(y1, s->y);
+    x2 = MAX(x2, s->x + s->w);
+    y2 = MAX(y2, s->y + s->h);
+  }
+  return (rect_t){ x1, y1, x2 - x1, y2 - y1 };
+}
@@ -0,0 +1,35 @@
+#ifndef __UI_REGION_H__
+#define __UI_REGION_H__
+
+#include <stdbool.h>
+
+typedef struct rect_s rect_t;
+
+// Region - a set of pixels stored as disjoint rects in y-x banded order.
+// Rects in a band share y and h and are sorted by x; horizontally touching
+// rects are merged and identical adjacent bands are coalesced.
+typedef struct region_s {
+  struct rect_s *rects;
+  int count;
+  int capacity;
+} region_t;
+
+void region_init(region_t *rgn);
+void region_free(region_t *rgn);
+void region_clear(region_t *rgn);
+bool region_is_empty(region_t const *rgn);
+
+// Add r to the region
+void region_union_rect(region_t *rgn, rect_t const *r);
+
+// Keep only the part of the region inside r
+void region_intersect_rect(region_t *rgn, rect_t const *r);
+
+// Remove the part of the region inside r
+void region_subtract_rect(region_t *rgn, rect_t const *r);
+
+bool region_intersects(region_t const *rgn, rect_t const *r);
+bool region_contains_rect(region_t const *rgn, rect_t const *r);
+rect_t region_bounds(region_t const *rgn);
+
+#endif
@@ -18,17 +18,12 @@
 #define SMALL_FONT_HEIGHT 8
 #define SMALL_LINE_HEIGHT 12
 #define SPACE_WIDTH 3
-#define VERTICES_PER_CHAR 6  // 2 triangles = 6 vertices
 
-typedef struct {
-  int16_t x, y;
-  float u, v;
-  uint32_t col;
-} text_vertex_t;
+// Glyph quads go straight into the sprite batch, one instance per glyph
+typedef sprite_instance_t text_glyph_t;
 
 // Font atlas structure
 typedef struct {
-  R_Mesh mesh;       // Mesh for rendering text
   R_Texture texture; // Atlas texture
   uint8_t char_from[256];    // Start position of each character in pixels
   uint8_t char_to[256];      // End position of each character in pixels
@@ -42,13 +37,158 @@ static struct {
   font_atlas_t small_font;   // Small 6x8 font atlas
 } text_state = {0};
 
+// Glyph-run cache
+// Labels are mostly drawn with the same text and color every frame, so
+// draw_text_small keeps their glyphs laid out at the origin and only adds
+// the position when queueing them. Least recently drawn runs are evicted
+// once the cache outgrows TEXT_CACHE_LIMIT.
+#define TEXT_CACHE_BUCKETS 1024
+#define TEXT_CACHE_LIMIT (256 * 1024)   // Bytes of cached runs
+#define TEXT_CACHE_MAX_LENGTH 256       // Longer strings are streamed as glyphs
+#define GLYPH_CHUNK 1024                // Glyphs reserved at a time when streaming
+
+typedef struct text_run_s {
+  struct text_run_s *next;            // Same bucket
+  struct text_run_s *newer, *older;   // Recently drawn order
+  uint32_t hash;
+  uint32_t col;
+  int length;
+  int count;                          // Glyphs; the text follows them
+  text_glyph_t glyphs[];
+} text_run_t;
+
+static struct {
+  text_run_t *buckets[TEXT_CACHE_BUCKETS];
+  text_run_t *newest, *oldest;
+  size_t bytes;
+} text_cache = {0};
+
+static inline char *run_text(text_run_t *run) {
+  return (char *)(run->glyphs + run->count);
+}
+
 // Helper to get character width
 static inline int get_char_width(unsigned char c) {
   return text_state.small_font.char_to[c] - text_state.small_font.char_from[c];
 }
 
-// Forward declarations for external functions
-extern void push_sprite_args(int tex, int x, int y, int w, int h, float alpha);
+// Queue glyphs for length bytes of text with the origin at (x, y);
+// returns how many were written to buffer
+static int layout_glyphs(text_glyph_t *buffer, const char* text, int text_length,
+                         int x, int y, uint32_t col) {
+  int glyph_count = 0;
+  int cursor_x = x;
+  
+  for (int i = 0; i < text_length; i++) {
+    unsigned char c = text[i];
+    
+    if (c == ' ') {
+      cursor_x += SPACE_WIDTH;
+      continue;
+    }
+    if (c == '\n') {
+      cursor_x = x;
+      y += SMALL_LINE_HEIGHT;
+      continue;
+    }
+    
+    // Calculate texture coordinates
+    int atlas_x = (c % text_state.small_font.chars_per_row) * SMALL_FONT_WIDTH;
+    int atlas_y = (c / text_state.small_font.chars_per_row) * SMALL_FONT_HEIGHT;
+    
+    uint8_t w = text_state.small_font.char_to[c] - text_state.small_font.char_from[c];
+    uint8_t h = SMALL_FONT_HEIGHT;
+    
+    // Source rect in atlas texels
+    buffer[glyph_count++] = (text_glyph_t) {
+      cursor_x, y, w, h,
+      atlas_x + text_state.small_font.char_from[c], atlas_y, w, h, col
+    };
+    
+    // Advance cursor position
+    cursor_x += w;
+  }
+  return glyph_count;
+}
+
+static void unlink_run(text_run_t *run) {
+  if (run->newer) run->newer->older = run->older;
+  else text_cache.newest = run->older;
+  if (run->older) run->older->newer = run->newer;
+  else text_cache.oldest = run->newer;
+}
+
+static void push_newest(text_run_t *run) {
+  run->newer = NULL;
+  run->older = text_cache.newest;
+  if (text_cache.newest) text_cache.newest->newer = run;
+  else text_cache.oldest = run;
+  text_cache.newest = run;
+}
+
+static size_t run_size(text_run_t const *run) {
+  return sizeof(text_run_t) + run->count * sizeof(text_glyph_t) + run->length + 1;
+}
+
+static void evict_run(text_run_t *run) {
+  text_run_t **link = &text_cache.buckets[run->hash % TEXT_CACHE_BUCKETS];
+  while (*link != run) link = &(*link)->next;
+  *link = run->next;
+  unlink_run(run);
+  text_cache.bytes -= run_size(run);
+  free(run);
+}
+
+static void clear_text_cache(void) {
+  while (text_cache.oldest) {
+    evict_run(text_cache.oldest);
+  }
+}
+
+// Bytes held by cached glyph runs
+size_t text_cache_size(void) {
+  return text_cache.bytes;
+}
+
+// Cached glyphs of text in col, laid out and added if missing. Returns NULL
+// for text too long to cache.
+static text_run_t *find_text_run(const char* text, uint32_t col) {
+  // FNV-1a over the text, measuring it on the way
+  uint32_t hash = 2166136261u;
+  int length = 0;
+  for (; text[length]; length++) {
+    if (length == TEXT_CACHE_MAX_LENGTH) return NULL;
+    hash = (hash ^ (unsigned char)text[length]) * 16777619u;
+  }
+  hash = (hash ^ col) * 16777619u;
+  
+  text_run_t **bucket = &text_cache.buckets[hash % TEXT_CACHE_BUCKETS];
+  for (text_run_t *run = *bucket; run; run = run->next) {
+    if (run->hash == hash && run->col == col && run->length == length &&
+        !memcmp(run_text(run), text, length)) {
+      unlink_run(run);
+      push_newest(run);
+      return run;
+    }
+  }
+  
+  text_run_t *run = malloc(sizeof(text_run_t) + length * sizeof(text_glyph_t) + length + 1);
+  if (!run) return NULL;
+  run->hash = hash;
+  run->col = col;
+  run->length = length;
+  run->count = layout_glyphs(run->glyphs, text, length, 0, 0, col);
+  memcpy(run_text(run), text, length + 1);
+  size_t size = run_size(run);
+  while (text_cache.oldest && text_cache.bytes + size > TEXT_CACHE_LIMIT) {
+    evict_run(text_cache.oldest);
+  }
+  run->next = *bucket;
+  *bucket = run;
+  push_newest(run);
+  text_cache.bytes += size;
+  return run;
+}
 
 // Create texture atlas for the small 6x8 font
 static bool create_font_atlas(void) {
@@ -93,6 +233,10 @@ static bool create_font_atlas(void) {
   size_t half = FONT_TEX_SIZE * FONT_TEX_SIZE / 2;
   memcpy(atlas_data + half, icons_bits, half);
   
+  // Character 0 is never drawn, so its first texel doubles as the
+  // opaque white texel used by fill_rect to stay in the text batch
+  atlas_data[0] = 255;
+  
   for (int i = 128; i < 256; i++) {
     text_state.small_font.char_to[i] = 8;
     text_state.small_font.char_from[i] = 0;
@@ -108,26 +252,19 @@ static bool create_font_atlas(void) {
 
   // Create OpenGL texture for the atlas
   R_AllocateFontTexture(&text_state.small_font.texture, atlas_data);  
+  set_solid_texel(text_state.small_font.texture.id, 0, 0);
   
   // Free temporary buffer
   free(atlas_data);
   
   printf("Small font atlas created successfully\n");
-  
-  // Initialize mesh for text rendering
-  // Vertex attribute layout: 0 = Position, 1 = UV, 2 = Color
-  R_VertexAttrib attribs[] = {
-    {0, 2, GL_SHORT, GL_FALSE, offsetof(text_vertex_t, x)},  // Position
-    {1, 2, GL_FLOAT, GL_FALSE, offsetof(text_vertex_t, u)},  // UV
-    {2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(text_vertex_t, col)} // Color
-  };
-  R_MeshInit(&text_state.small_font.mesh, attribs, 3, sizeof(text_vertex_t), GL_TRIANGLES);
 
   return true;
 }
 
 // Initialize text rendering system
 void init_text_rendering(void) {
+  clear_text_cache();
   memset(&text_state, 0, sizeof(text_state));
   create_font_atlas();
 }
@@ -159,6 +296,51 @@ int strwidth(const char* text) {
   return strnwidth(text, (int)strlen(text));
 }
 
+// Queue length bytes of text as glyph instances a chunk at a time, so it
+// can be any length. Lines wrap at width unless it is 0. Only lines that
+// overlap [top, bottom) get glyphs, and glyphs that don't fit the 16-bit
+// coordinates of an instance are skipped.
+static void stream_glyphs(const char* text, size_t length, int x, int y, int width,
+                          int top, int bottom, uint32_t col) {
+  const char *end = text + length;
+  int cx = x;
+  top = MAX(top, INT16_MIN + SMALL_FONT_HEIGHT);
+  bottom = MIN(bottom, INT16_MAX - SMALL_FONT_HEIGHT);
+  while (text < end && y < bottom) {
+    uint8_t color;
+    glyph_instance_t *buffer = reserve_glyphs(text_state.small_font.texture.id, GLYPH_CHUNK, col, &color);
+    if (!buffer) return;
+    int glyph_count = 0;
+    for (; text < end && glyph_count < GLYPH_CHUNK; text++) {
+      unsigned char c = *text;
+      if (c == '\n') {
+        cx = x;
+        y += SMALL_LINE_HEIGHT;
+        continue;
+      }
+      if (c == ' ') {
+        cx += SPACE_WIDTH;
+        continue;
+      }
+      
+      int cw = get_char_width(c);
+      if (width > 0 && cx + cw > x + width) {
+        cx = x;
+        y += SMALL_LINE_HEIGHT;
+      }
+      // Lines only go down, so nothing after the band is visible
+      if (y >= bottom) break;
+      if (y + SMALL_FONT_HEIGHT > top && cx >= INT16_MIN && cx + cw <= INT16_MAX) {
+        buffer[glyph_count++] = (glyph_instance_t) {
+          cx, y, c, text_state.small_font.char_from[c], cw, color
+        };
+      }
+      cx += cw;
+    }
+    commit_glyphs(glyph_count);
+  }
+}
+
 // Draw text using small bitmap font
 void draw_text_small(const char* text, int x, int y, uint32_t col) {
   extern bool running;
@@ -168,77 +350,21 @@ void draw_text_small(const char* text, int x, int y, uint32_t col) {
   // Skip drawing if graphics aren't initialized (e.g., in tests)
   if (!running) return;
   
-  int text_length = (int)strlen(text);
-  if (text_length > MAX_TEXT_LENGTH) text_length = MAX_TEXT_LENGTH;
-  
-  static text_vertex_t buffer[MAX_TEXT_LENGTH * VERTICES_PER_CHAR];
-  int vertex_count = 0;
-  
-  int cursor_x = x;
-  
-  // Pre-calculate all vertices for the entire string
-  for (int i = 0; i < text_length; i++) {
-    unsigned char c = text[i];
-    
-    if (c == ' ') {
-      cursor_x += SPACE_WIDTH;
-      continue;
-    }
-    if (c == '\n') {
-      cursor_x = x;
-      y += SMALL_LINE_HEIGHT;
-      continue;
-    }
-    
-    // Calculate texture coordinates
-    int atlas_x = (c % text_state.small_font.chars_per_row) * SMALL_FONT_WIDTH;
-    int atlas_y = (c / text_state.small_font.chars_per_row) * SMALL_FONT_HEIGHT;
-    
-    // Convert to normalized UV coordinates (0-255 range for uint8_t)
-    float u1 = (atlas_x + text_state.small_font.char_from[c])/(float)FONT_TEX_SIZE;
-    float v1 = (atlas_y)/(float)FONT_TEX_SIZE;
-    float u2 = (atlas_x + text_state.small_font.char_to[c])/(float)FONT_TEX_SIZE;
-    float v2 = (atlas_y + SMALL_FONT_HEIGHT)/(float)FONT_TEX_SIZE;
-    
-    uint8_t w = text_state.small_font.char_to[c] - text_state.small_font.char_from[c];
-    uint8_t h = SMALL_FONT_HEIGHT;
-    
-    // Skip spaces to save rendering effort
-    if (c != ' ') {
-      // First triangle (bottom-left, top-left, bottom-right)
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x, y, u1, v1, col };
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x, y + h, u1, v2, col };
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x + w, y, u2, v1, col };
-      
-      // Second triangle (top-left, top-right, bottom-right)
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x, y + h, u1, v2, col };
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x + w, y + h, u2, v2, col };
-      buffer[vertex_count++] = (text_vertex_t) { cursor_x + w, y, u2, v1, col };
-    }
-    
-    // Advance cursor position
-    cursor_x += w;
+  // Labels share the sprite batch with fills; long text is streamed
+  text_run_t *run = find_text_run(text, col);
+  if (!run) {
+    stream_glyphs(text, strlen(text), x, y, 0, INT16_MIN, INT16_MAX, col);
+    return;
   }
   
-  // Early return if nothing to draw
-  if (vertex_count == 0) return;
-  
-  // Set up GL state
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glDisable(GL_DEPTH_TEST);
-  
-  // Get locations for shader uniforms
-  push_sprite_args(text_state.small_font.texture.id, 0, 0, 1, 1, 1);
-  
-  // Bind font texture and draw
-  R_TextureBind(&text_state.small_font.texture);
-  R_MeshDrawDynamic(&text_state.small_font.mesh, buffer, vertex_count);
-  
-  // Restore GL state
-  // Note: Commented out to match original behavior
-  // glEnable(GL_DEPTH_TEST);
-  // glDisable(GL_BLEND);
+  text_glyph_t *buffer = reserve_sprites(text_state.small_font.texture.id, run->count);
+  if (!buffer) return;
+  for (int i = 0; i < run->count; i++) {
+    buffer[i] = run->glyphs[i];
+    buffer[i].x += x;
+    buffer[i].y += y;
+  }
+  commit_sprites(run->count);
 }
 
 // Calculate total height of text with wrapping
@@ -276,66 +402,97 @@ void draw_text_wrapped(const char* text, rect_t const *viewport, uint32_t col) {
   // Check if text_state is initialized
   if (text_state.small_font.char_height == 0) return;
   
-  int x = viewport->x;
-  int y = viewport->y;
-  int width = viewport->w;
-  int height = viewport->h;
-  
-  static text_vertex_t buffer[MAX_TEXT_LENGTH * VERTICES_PER_CHAR];
-  int vertex_count = 0, cx = x, cy = y;
+  // Lines above and below the viewport are skipped without emitting glyphs
+  stream_glyphs(text, strlen(text), viewport->x, viewport->y, viewport->w,
+                viewport->y, viewport->y + viewport->h, col);
+}
+
+static bool add_line(text_layout_t *layout, size_t start) {
+  if (layout->num_lines == layout->max_lines) {
+    int max_lines = MAX(64, layout->max_lines * 2);
+    uint32_t *lines = realloc(layout->lines, max_lines * sizeof(uint32_t));
+    if (!lines) return false;
+    layout->lines = lines;
+    layout->max_lines = max_lines;
+  }
+  layout->lines[layout->num_lines++] = (uint32_t)start;
+  return true;
+}
+
+// Extend the layout over text[layout->length, length), wrapping like
+// draw_text_wrapped. A new width or shorter text starts over.
+void update_text_layout(text_layout_t *layout, const char* text, size_t length, int width) {
+  if (layout->width != width || length < layout->length) {
+    reset_text_layout(layout);
+    layout->width = width;
+  }
+  if (!text || width <= 0 || length == layout->length) return;
+  if (layout->num_lines == 0 && !add_line(layout, 0)) return;
   
-  for (const char* p = text; *p && vertex_count < MAX_TEXT_LENGTH * VERTICES_PER_CHAR - VERTICES_PER_CHAR; p++) {
-    unsigned char c = *p;
+  int x = layout->cursor_x;
+  for (size_t i = layout->length; i < length; i++) {
+    unsigned char c = text[i];
     if (c == '\n') {
-      cx = x;
-      cy += SMALL_LINE_HEIGHT;
-      continue;
-    }
-    if (c == ' ') {
-      cx += 3;
-      continue;
-    }
-    
-    int cw = get_char_width(c);
-    if (cx + cw > x + width) {
-      cx = x;
-      cy += SMALL_LINE_HEIGHT;
+      if (!add_line(layout, i + 1)) break;
+      x = 0;
+    } else if (c == ' ') {
+      x += SPACE_WIDTH;
+    } else {
+      int cw = get_char_width(c);
+      if (x + cw > width) {
+        if (!add_line(layout, i)) break;
+        x = cw;
+      } else {
+        x += cw;
+      }
     }
-    
-    // Show character if any part of it is visible in viewport
-    // if (cy + SMALL_FONT_HEIGHT > y && cy < y + height) {
-      int ax = (c % text_state.small_font.chars_per_row) * SMALL_FONT_WIDTH;
-      int ay = (c / text_state.small_font.chars_per_row) * SMALL_FONT_HEIGHT;
-      float u1 = (ax + text_state.small_font.char_from[c]) / (float)FONT_TEX_SIZE;
-      float v1 = ay / (float)FONT_TEX_SIZE;
-      float u2 = (ax + text_state.small_font.char_to[c]) / (float)FONT_TEX_SIZE;
-      float v2 = (ay + SMALL_FONT_HEIGHT) / (float)FONT_TEX_SIZE;
-      
-      buffer[vertex_count++] = (text_vertex_t){cx, cy, u1, v1, col};
-      buffer[vertex_count++] = (text_vertex_t){cx, cy + SMALL_FONT_HEIGHT, u1, v2, col};
-      buffer[vertex_count++] = (text_vertex_t){cx + cw, cy, u2, v1, col};
-      buffer[vertex_count++] = (text_vertex_t){cx, cy + SMALL_FONT_HEIGHT, u1, v2, col};
-      buffer[vertex_count++] = (text_vertex_t){cx + cw, cy + SMALL_FONT_HEIGHT, u2, v2, col};
-      buffer[vertex_count++] = (text_vertex_t){cx + cw, cy, u2, v1, col};
-    // }
-    cx += cw;
+    layout->length = i + 1;
   }
+  layout->cursor_x = x;
+}
+
+void reset_text_layout(text_layout_t *layout) {
+  layout->length = 0;
+  layout->cursor_x = 0;
+  layout->num_lines = 0;
+}
+
+void free_text_layout(text_layout_t *layout) {
+  free(layout->lines);
+  memset(layout, 0, sizeof(text_layout_t));
+}
+
+// Height of the laid out text; matches calc_text_height
+int text_layout_height(text_layout_t const *layout) {
+  return layout->num_lines * SMALL_LINE_HEIGHT;
+}
+
+// Draw the lines of a laid out text that fall in viewport, scrolled up by
+// scroll pixels. Lines are placed relative to the viewport before becoming
+// 16-bit glyph coordinates, so the text can be taller than that range.
+void draw_text_layout(text_layout_t const *layout, const char* text,
+                      rect_t const *viewport, int scroll, uint32_t col) {
+  extern bool running;
+  if (!text || !running || !viewport || layout->num_lines == 0) return;
   
-  if (vertex_count == 0) return;
-  
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glDisable(GL_DEPTH_TEST);
-  push_sprite_args(text_state.small_font.texture.id, 0, 0, 1, 1, 1);
-  R_TextureBind(&text_state.small_font.texture);
-  R_MeshDrawDynamic(&text_state.small_font.mesh, buffer, vertex_count);
+  // Lines are all the same height, so the visible ones are found directly
+  int first = MAX(0, (scroll - SMALL_FONT_HEIGHT + SMALL_LINE_HEIGHT) / SMALL_LINE_HEIGHT);
+  int last = MIN(layout->num_lines, (scroll + viewport->h + SMALL_LINE_HEIGHT - 1) / SMALL_LINE_HEIGHT);
+  for (int i = first; i < last; i++) {
+    size_t start = layout->lines[i];
+    size_t end = i + 1 < layout->num_lines ? layout->lines[i + 1] : layout->length;
+    int y = viewport->y + i * SMALL_LINE_HEIGHT - scroll;
+    stream_glyphs(text + start, end - start, viewport->x, y, 0, INT16_MIN, INT16_MAX, col);
+  }
 }
 
 // Clean up text rendering resources
 void shutdown_text_rendering(void) {
   // Delete small font resources
-  SAFE_DELETE_N(text_state.small_font.texture.id, glDeleteTextures);
-  R_MeshDestroy(&text_state.small_font.mesh);
+  flush_sprites();
+  set_solid_texel(0, 0, 0);
+  R_DeleteTexture(&text_state.small_font.texture.id);
+  clear_text_cache();
   
   // Clear the entire state
   memset(&text_state, 0, sizeof(text_state));
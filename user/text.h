@@ -1,6 +1,7 @@
 #ifndef __UI_TEXT_H__
 #define __UI_TEXT_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -24,4 +25,24 @@ int strnwidth(const char* text, int text_length);
 int calc_text_height(const char* text, int width);
 void draw_text_wrapped(const char* text, rect_t const *viewport, uint32_t col);
 
+// Line breaks of a growing text wrapped to a width. Updating it only scans
+// text appended since the last update, so long buffers such as a terminal's
+// scrollback can be measured and painted by their visible lines alone.
+typedef struct text_layout_s {
+  int width;                 // Wrap width the breaks were found for
+  size_t length;             // Bytes of text laid out
+  int cursor_x;              // Pen position after the last byte
+  uint32_t *lines;           // Byte offset where each line starts
+  int num_lines, max_lines;
+} text_layout_t;
+
+void update_text_layout(text_layout_t *layout, const char* text, size_t length, int width);
+void reset_text_layout(text_layout_t *layout);  // Call when the text is replaced
+void free_text_layout(text_layout_t *layout);
+int text_layout_height(text_layout_t const *layout);
+// Draw the lines of a laid out text that overlap viewport, scrolled up by
+// scroll pixels; the text may be taller than 16-bit coordinates allow
+void draw_text_layout(text_layout_t const *layout, const char* text,
+                      rect_t const *viewport, int scroll, uint32_t col);
+
 #endif // __UI_TEXT_H__
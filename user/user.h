@@ -5,6 +5,7 @@
 #include <stdbool.h>
 
 #include "messages.h"
+#include "region.h"
 #include "../kernel/kernel.h" 
 
 // Forward declarations
@@ -12,6 +13,7 @@ typedef struct window_s window_t;
 typedef struct rect_s rect_t;
 typedef uint32_t flags_t;
 typedef uint32_t result_t;
+typedef uint32_t hwnd_t;  // Window handle; 0 is never a valid one
 
 // Window procedure callback type
 typedef result_t (*winproc_t)(window_t *, uint32_t, uint32_t, void *);
@@ -40,38 +42,71 @@ typedef struct {
   flags_t flags;
 } windef_t;
 
-// Window structure
+typedef struct pending_msg_s pending_msg_t;
+typedef struct hit_grid_s hit_grid_t;
+typedef struct item_table_s item_table_t;
+typedef struct window_arena_s window_arena_t;
+
+#define WINDOW_TITLE_SIZE 64
+
+// Rarely used state of every window, kept out of tree walks
+typedef struct window_cold_s {
+  char title[WINDOW_TITLE_SIZE];
+  uint32_t child_id;               // Last ID given to a child
+  uint32_t item_id;                // ID this window was indexed under
+  uint32_t cursor_pos;
+  void *userdata2;
+  pending_msg_t *pending;          // Messages queued for this window
+  hit_grid_t *hit_grid;            // Children indexed for hit testing
+  window_t *last_child;            // Only needed to append children
+} window_cold_t;
+
+// State only top-level windows have
+typedef struct window_top_s {
+  char statusbar_text[64];
+  uint32_t num_toolbar_buttons;
+  toolbar_button_t *toolbar_buttons;
+  R_Framebuffer surface;           // Offscreen copy of the window when compositing
+  region_t damage;                 // Client area awaiting a paint
+  region_t visible_region;         // Screen area not covered by windows above
+  item_table_t *items;             // Descendants by ID
+  window_arena_t *arena;           // WINDOW_ARENA only: memory of descendants
+} window_top_t;
+
+// Window structure. The fields hit testing and painting walk over come
+// first; the rest is in cold, and in top for top-level windows.
 struct window_s {
   rect_t frame;
-  uint32_t id;
-  uint16_t scroll[2];
   uint32_t flags;
+  uint32_t id;
   winproc_t proc;
-  uint32_t child_id;
-  bool hovered;
-  bool editing;
-  bool notabstop;
-  bool pressed;
-  bool value;
-  bool visible;
-  bool disabled;
-  char title[64];
-  char statusbar_text[64];
-  uint32_t cursor_pos;
-  uint32_t num_toolbar_buttons;
-  toolbar_button_t *toolbar_buttons;
-  void *userdata;
-  void *userdata2;
-  struct window_s *next;
-  struct window_s *children;
+  struct window_s *next;           // Sibling in front
+  struct window_s *children;       // Back to front
   struct window_s *parent;
+  uint16_t scroll[2];
+  bool visible : 1;
+  bool disabled : 1;
+  bool dirty : 1;                  // Invalidated since display_list was recorded
+  bool notabstop : 1;
+  bool hovered : 1;
+  bool editing : 1;
+  bool pressed : 1;
+  bool value : 1;
+  hwnd_t handle;
+  display_list_t *display_list;    // Last kWindowMessagePaint output
+  void *userdata;
+  struct window_s *prev;           // Sibling behind
+  window_cold_t *cold;
+  window_top_t *top;               // NULL for child windows
 };
 
 // Window management functions
 window_t *create_window(char const *title, flags_t flags, const rect_t* frame, 
                         window_t *parent, winproc_t proc, void *param);
 window_t *create_window2(windef_t const *def, rect_t const *r, window_t *parent);
-void *allocate_window_data(window_t *win, size_t size);
+void *allocate_window_data(window_t *win, size_t size);  // Zeroed, released with free()
+void *alloc_window_memory(window_t *win, size_t size);  // Zeroed, pooled
+void free_window_memory(void *ptr);
 void show_window(window_t *win, bool visible);
 void destroy_window(window_t *win);
 void clear_window_children(window_t *win);
@@ -81,11 +116,28 @@ void resize_window(window_t *win, int new_w, int new_h);
 // Window message functions
 int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
 void post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
+void post_idle_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
 void invalidate_window(window_t *win);
+void invalidate_rect(window_t *win, rect_t const *r);
+
+// Message queue counters
+typedef struct {
+  uint32_t posted;      // post_message calls that queued a message
+  uint32_t coalesced;   // ...replacing a queued duplicate
+  uint32_t dropped;     // Messages lost because the queue couldn't grow
+  uint32_t high_water;  // Most slots in use at once
+  uint32_t capacity;    // Current slots
+} message_queue_stats_t;
+
+message_queue_stats_t get_message_queue_stats(void);
 
 // Window query functions
+// Find a descendant by ID. If several share it, the one created first wins;
+// once it is gone or renumbered, the first in depth-first child order.
 window_t *get_window_item(window_t const *win, uint32_t id);
 bool is_window(window_t *win);
+hwnd_t get_window_handle(window_t const *win);
+window_t *window_from_handle(hwnd_t handle);  // NULL once destroyed
 int window_title_bar_y(window_t const *win);
 window_t *get_root_window(window_t *window);
 window_t *find_window(int x, int y);
@@ -104,6 +156,11 @@ void set_capture(window_t *win);
 void track_mouse(window_t *win);
 void move_to_top(window_t* win);
 
+// Compositing - top-level windows paint into their own surface and the
+// frame is assembled from those (see UI_INIT_COMPOSITE)
+void enable_compositing(bool enable);
+bool is_compositing(void);
+
 // Window hook registration
 void register_window_hook(uint32_t msg, winhook_func_t func, void *userdata);
 void deregister_window_hook(uint32_t msg, winhook_func_t func, void *userdata);
@@ -12,11 +12,44 @@
 #include "draw.h"
 
 // Global window state
-window_t *windows = NULL;
+window_t *windows = NULL;  // Top-level windows, back to front
 window_t *_focused = NULL;
 window_t *_tracked = NULL;
 window_t *_captured = NULL;
 
+// Top-level window IDs, one bit each. ID 0 is reserved for "no window".
+static struct {
+  uint64_t *words;
+  uint32_t num_words;
+  uint32_t first_free;  // Words before this one are full
+  uint32_t count;       // IDs in use; the bitmap is freed when it drops to 0
+} window_ids = {0};
+
+// Top-level z-order bands, back to front. The windows of a band are
+// contiguous in the windows list, so each band is tracked by its frontmost.
+enum {
+  kLayerBack,     // WINDOW_ALWAYSINBACK
+  kLayerNormal,
+  kLayerTop,      // WINDOW_ALWAYSONTOP
+  kLayerPopup,    // WINDOW_POPUP
+  kNumLayers
+};
+
+static window_t *windows_tail = NULL;
+static window_t *layer_tops[kNumLayers] = {0};
+
+// Descendants of a top-level window by ID: open addressing, linear probing.
+// Slots are a cache checked against the window's current ID, so IDs assigned
+// directly are picked up by a search on the first lookup.
+struct item_table_s {
+  uint32_t capacity;  // Power of two
+  uint32_t count;
+  struct {
+    uint32_t id;
+    window_t *win;    // NULL if the slot is free
+  } *slots;
+};
+
 static window_t *_dragging = NULL;
 static window_t *_resizing = NULL;
 //static int drag_anchor[2];
@@ -24,18 +57,182 @@ static window_t *_resizing = NULL;
 // Forward declarations
 extern void post_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
 extern int send_message(window_t *win, uint32_t msg, uint32_t wparam, void *lparam);
+extern int titlebar_height(window_t const *win);
+extern int statusbar_height(window_t const *win);
+extern void invalidate_hit_test(window_t *win);
+extern window_t *hit_test_top_level(int x, int y);
+extern void free_hit_grid(window_t *win);
+extern hwnd_t alloc_window_handle(window_t *win);
+extern void free_window_handle(window_t *win);
+extern window_t *alloc_window(window_t *parent);
+extern void free_window(window_t *win);
+extern void release_window_arena(window_t *root, bool keep);
+
+// Link win into a sibling list after prev, or first if prev is NULL
+static void link_window(window_t *win, window_t *prev, window_t **head, window_t **tail) {
+  win->prev = prev;
+  win->next = prev ? prev->next : *head;
+  if (win->next) win->next->prev = win;
+  else *tail = win;
+  if (prev) prev->next = win;
+  else *head = win;
+}
+
+static void unlink_window(window_t *win, window_t **head, window_t **tail) {
+  if (win->prev) win->prev->next = win->next;
+  else *head = win->next;
+  if (win->next) win->next->prev = win->prev;
+  else *tail = win->prev;
+  win->prev = win->next = NULL;
+}
+
+static int window_layer(window_t const *win) {
+  if (win->flags & WINDOW_POPUP) return kLayerPopup;
+  if (win->flags & WINDOW_ALWAYSONTOP) return kLayerTop;
+  if (win->flags & WINDOW_ALWAYSINBACK) return kLayerBack;
+  return kLayerNormal;
+}
+
+// Put a top-level window in front of the others in its band
+static void insert_top_level(window_t *win) {
+  int layer = window_layer(win);
+  window_t *prev = NULL;
+  for (int l = layer; l >= 0 && !prev; l--) {
+    prev = layer_tops[l];
+  }
+  link_window(win, prev, &windows, &windows_tail);
+  layer_tops[layer] = win;
+}
+
+// The window behind the top of a band is either in the same band or the
+// top of a band below it
+static void remove_top_level(window_t *win) {
+  for (int l = 0; l < kNumLayers; l++) {
+    if (layer_tops[l] != win) continue;
+    layer_tops[l] = win->prev;
+    for (int k = 0; k < l; k++) {
+      if (layer_tops[k] == win->prev) layer_tops[l] = NULL;
+    }
+  }
+  unlink_window(win, &windows, &windows_tail);
+}
+
+// Bring a top-level window to the front of its band; false if it already was
+bool raise_top_level(window_t *win) {
+  if (win->parent || layer_tops[window_layer(win)] == win) return false;
+  remove_top_level(win);
+  insert_top_level(win);
+  return true;
+}
+
+// Hand out the lowest free top-level ID, growing the bitmap when it's full
+static uint32_t alloc_window_id(void) {
+  uint32_t i = window_ids.first_free;
+  while (i < window_ids.num_words && window_ids.words[i] == ~0ull) i++;
+  if (i == window_ids.num_words) {
+    uint32_t num_words = MAX(4, window_ids.num_words * 2);
+    uint64_t *words = realloc(window_ids.words, num_words * sizeof(uint64_t));
+    if (!words) return 0;
+    memset(words + window_ids.num_words, 0, (num_words - window_ids.num_words) * sizeof(uint64_t));
+    if (window_ids.num_words == 0) words[0] = 1;
+    window_ids.words = words;
+    window_ids.num_words = num_words;
+  }
+  uint32_t bit = __builtin_ctzll(~window_ids.words[i]);
+  window_ids.words[i] |= 1ull << bit;
+  window_ids.first_free = i;
+  window_ids.count++;
+  return i * 64 + bit;
+}
+
+static void free_window_id(uint32_t id) {
+  uint32_t i = id / 64;
+  uint64_t mask = 1ull << (id % 64);
+  if (id == 0 || i >= window_ids.num_words || !(window_ids.words[i] & mask)) return;
+  window_ids.words[i] &= ~mask;
+  window_ids.first_free = MIN(window_ids.first_free, i);
+  if (--window_ids.count == 0) {
+    free(window_ids.words);
+    memset(&window_ids, 0, sizeof(window_ids));
+  }
+}
+
+static uint32_t item_slot(item_table_t const *table, uint32_t id) {
+  return (id * 0x9E3779B1u) & (table->capacity - 1);
+}
 
-// Window list management
-void push_window(window_t *win, window_t **windows) {
-  if (!*windows) {
-    *windows = win;
+// Slot holding id, or the free slot where it would go
+static uint32_t find_item_slot(item_table_t const *table, uint32_t id) {
+  uint32_t i = item_slot(table, id);
+  while (table->slots[i].win && table->slots[i].id != id) {
+    i = (i + 1) & (table->capacity - 1);
+  }
+  return i;
+}
+
+static bool grow_item_table(item_table_t *table) {
+  item_table_t old = *table;
+  table->capacity = MAX(16, old.capacity * 2);
+  table->count = 0;
+  if (!(table->slots = calloc(table->capacity, sizeof(*table->slots)))) {
+    *table = old;
+    return false;
+  }
+  for (uint32_t i = 0; i < old.capacity; i++) {
+    if (old.slots[i].win) {
+      table->slots[find_item_slot(table, old.slots[i].id)] = old.slots[i];
+      table->count++;
+    }
+  }
+  free(old.slots);
+  return true;
+}
+
+// Point the root's slot for id at win, unless it holds a live window with it
+static void index_window_item(window_t *win, uint32_t id) {
+  window_t *root = get_root_window(win);
+  if (root == win) return;
+  if (!root->top->items && !(root->top->items = calloc(1, sizeof(item_table_t)))) return;
+  item_table_t *table = root->top->items;
+  if ((table->count + 1) * 4 > table->capacity * 3 && !grow_item_table(table)) return;
+  uint32_t i = find_item_slot(table, id);
+  if (table->slots[i].win) {
+    if (table->slots[i].win->id == id) return;
   } else {
-    window_t *p = *windows;
-    while (p->next) p = p->next;
-    p->next = win;
+    table->count++;
+  }
+  table->slots[i].id = id;
+  table->slots[i].win = win;
+  win->cold->item_id = id;
+}
+
+// Drop win's slot, shifting later entries of the probe run back into the gap
+static void unindex_window_item(window_t *win) {
+  item_table_t *table = get_root_window(win)->top->items;
+  if (!table || !table->count) return;
+  uint32_t mask = table->capacity - 1;
+  uint32_t i = find_item_slot(table, win->cold->item_id);
+  if (table->slots[i].win != win) return;
+  table->slots[i].win = NULL;
+  table->count--;
+  for (uint32_t j = (i + 1) & mask; table->slots[j].win; j = (j + 1) & mask) {
+    uint32_t home = item_slot(table, table->slots[j].id);
+    // Move j into the gap unless its home lies cyclically in (i, j]
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      table->slots[i] = table->slots[j];
+      table->slots[j].win = NULL;
+      i = j;
+    }
   }
 }
 
+static void free_item_table(window_t *win) {
+  if (!win->top || !win->top->items) return;
+  free(win->top->items->slots);
+  free(win->top->items);
+  win->top->items = NULL;
+}
+
 // Create a new window
 window_t* create_window(char const *title,
                         flags_t flags,
@@ -44,32 +241,28 @@ window_t* create_window(char const *title,
                         winproc_t proc,
                         void *lparam)
 {
-  window_t *win = malloc(sizeof(window_t));
-  memset(win, 0, sizeof(window_t));
+  window_t *win = alloc_window(parent);
+  if (!win) return NULL;
   win->frame = *frame;
   win->proc = proc;
   win->flags = flags;
   if (parent) {
-    win->id = ++parent->child_id;
-  } else {
-    bool used[256]={0};
-    for (window_t *w = windows; w; w = w->next) {
-      used[w->id] = true;
-    }
-    for (int i = 1; i < 256; i++) {
-      if (!used[i]) {
-        win->id = i;
-      }
-    }
-    if (win->id == 0) {
-      printf("Too many windows open\n");
-    }
+    win->id = ++parent->cold->child_id;
+  } else if (!(win->id = alloc_window_id())) {
+    printf("Too many windows open\n");
   }
   win->parent = parent;
-  strncpy(win->title, title, sizeof(win->title));
+  win->handle = alloc_window_handle(win);
+  strncpy(win->cold->title, title, sizeof(win->cold->title));
   _focused = win;
-  push_window(win, parent ? &parent->children : &windows);
+  if (parent) {
+    link_window(win, parent->cold->last_child, &parent->children, &parent->cold->last_child);
+    index_window_item(win, win->id);
+  } else {
+    insert_top_level(win);
+  }
   send_message(win, kWindowMessageCreate, 0, lparam);
+  invalidate_hit_test(win);
   if (parent) {
     invalidate_window(win);
   }
@@ -95,50 +288,114 @@ bool do_windows_overlap(const window_t *a, const window_t *b) {
   a->frame.y < b->frame.y + b->frame.h && a->frame.y + a->frame.h > b->frame.y;
 }
 
-// Invalidate overlapping windows
+// Screen rect a top-level window draws into, including the frame drawn one
+// pixel outside it
+rect_t window_outer_rect(window_t const *win) {
+  int t = titlebar_height(win);
+  int s = statusbar_height(win);
+  return (rect_t){ win->frame.x-1, win->frame.y-t-1, win->frame.w+2, win->frame.h+t+s+2 };
+}
+
+// Recompute the visible region of each top-level window touching changed:
+// its outer rect minus the outer rects of visible windows above it
+static void update_visible_regions(region_t const *changed) {
+  for (window_t *w = windows; w; w = w->next) {
+    rect_t r = window_outer_rect(w);
+    if (!region_intersects(changed, &r)) continue;
+    region_clear(&w->top->visible_region);
+    if (!w->visible) continue;
+    region_union_rect(&w->top->visible_region, &r);
+    for (window_t *above = w->next; above; above = above->next) {
+      if (region_is_empty(&w->top->visible_region)) break;
+      if (above->visible) {
+        rect_t a = window_outer_rect(above);
+        region_subtract_rect(&w->top->visible_region, &a);
+      }
+    }
+  }
+}
+
+// Update visible regions after a top-level window moved, resized, was shown,
+// hidden, raised or destroyed. Only windows overlapping its old rect (NULL if
+// it didn't change) or its current one can be affected.
+void update_window_visibility(window_t *win, rect_t const *old) {
+  if (win->parent) return;
+  region_t changed;
+  region_init(&changed);
+  rect_t r = window_outer_rect(win);
+  region_union_rect(&changed, &r);
+  if (old) region_union_rect(&changed, old);
+  update_visible_regions(&changed);
+  region_free(&changed);
+}
+
+// Damage covering any client area; clipped to the window when painted
+static const rect_t whole_window = { 0, 0, INT16_MAX, INT16_MAX };
+
+// Repaint a window without discarding its display list
+static void repaint_window(window_t *win) {
+  if (!win->parent) {
+    region_union_rect(&win->top->damage, &whole_window);
+    post_message(win, kWindowMessageNonClientPaint, 0, NULL);
+  }
+  post_message(win, kWindowMessagePaint, 0, NULL);
+}
+
+// Mark a window and its ancestors as needing to run their paint procedure,
+// since a parent's display list includes what its children drew
+static void mark_dirty(window_t *win) {
+  for (; win; win = win->parent) {
+    win->dirty = true;
+  }
+}
+
+// Repaint overlapping windows; their contents haven't changed.
+// Composited windows are redrawn from their surfaces instead.
 static void invalidate_overlaps(window_t *win) {
+  if (is_compositing()) return;
   for (window_t *t = windows; t; t = t->next) {
     if (t != win && do_windows_overlap(t, win)) {
-      invalidate_window(t);
+      repaint_window(t);
     }
   }
 }
 
 // Move window to new position
 void move_window(window_t *win, int x, int y) {
+  rect_t old = window_outer_rect(win);
   post_message(win, kWindowMessageResize, 0, NULL);
-  post_message(win, kWindowMessageRefreshStencil, 0, NULL);
 
   invalidate_overlaps(win);
-  invalidate_window(win);
+  if (!is_compositing() || win->parent) {
+    invalidate_window(win);
+  }
 
   win->frame.x = x;
   win->frame.y = y;
+  invalidate_hit_test(win);
+  update_window_visibility(win, &old);
 }
 
 // Resize window
 void resize_window(window_t *win, int new_w, int new_h) {
+  rect_t old = window_outer_rect(win);
   post_message(win, kWindowMessageResize, 0, NULL);
-  post_message(win, kWindowMessageRefreshStencil, 0, NULL);
 
   invalidate_overlaps(win);
   invalidate_window(win);
 
   win->frame.w = new_w > 0 ? new_w : win->frame.w;
   win->frame.h = new_h > 0 ? new_h : win->frame.h;
+  invalidate_hit_test(win);
+  update_window_visibility(win, &old);
 }
 
-// Remove window from global window list
+// Remove window from its parent's children or the global window list
 static void remove_from_global_list(window_t *win) {
-  if (win == windows) {
-    windows = win->next;
-  } else if (windows) {
-    for (window_t *w=windows->next,*p=windows;w;p=w,w=w->next) {
-      if (w == win) {
-        p->next = w->next;
-        break;
-      }
-    }
+  if (win->parent) {
+    unlink_window(win, &win->parent->children, &win->parent->cold->last_child);
+  } else {
+    remove_top_level(win);
   }
 }
 
@@ -148,6 +405,9 @@ extern void remove_from_global_hooks(window_t *win);
 // Remove window from message queue
 extern void remove_from_global_queue(window_t *win);
 
+// Release the compositor surface
+extern void free_window_surface(window_t *win);
+
 // Clear all child windows
 void clear_window_children(window_t *win) {
   for (window_t *item = win->children, *next = item ? item->next : NULL;
@@ -155,11 +415,13 @@ void clear_window_children(window_t *win) {
     destroy_window(item);
   }
   win->children = NULL;
+  win->cold->last_child = NULL;
+  // Nothing in the arena is in use any more
+  if (!win->parent) release_window_arena(win, true);
 }
 
 // Destroy a window
 void destroy_window(window_t *win) {
-  post_message((window_t*)1, kWindowMessageRefreshStencil, 0, NULL);
   invalidate_overlaps(win);
   send_message(win, kWindowMessageDestroy, 0, NULL);
   if (_focused == win) set_focus(NULL);
@@ -167,33 +429,35 @@ void destroy_window(window_t *win) {
   if (_tracked == win) track_mouse(NULL);
   if (_dragging == win) _dragging = NULL;
   if (_resizing == win) _resizing = NULL;
-  if (win->toolbar_buttons) free(win->toolbar_buttons);
+  mark_dirty(win->parent);
+  free_display_list(win->display_list);
+  if (win->top) {
+    free_window_memory(win->top->toolbar_buttons);
+    free_window_surface(win);
+    region_free(&win->top->damage);
+  }
+  unindex_window_item(win);
   remove_from_global_list(win);
+  free_hit_grid(win);
+  if (!win->parent) free_window_id(win->id);
+  update_window_visibility(win, NULL);
+  if (win->top) region_free(&win->top->visible_region);
   remove_from_global_hooks(win);
   remove_from_global_queue(win);
   clear_window_children(win);
-  free(win);
+  free_item_table(win);
+  free_window_handle(win);
+  release_window_arena(win, false);
+  free_window(win);
 }
 
-// Find window at coordinates
-#define CONTAINS(x, y, x1, y1, w1, h1) \
-((x1) <= (x) && (y1) <= (y) && (x1) + (w1) > (x) && (y1) + (h1) > (y))
-
-extern int titlebar_height(window_t const *win);
-extern int statusbar_height(window_t const *win);
-
+// Find window at coordinates: the topmost visible window there, or the child
+// its hit test picks
 window_t *find_window(int x, int y) {
-  window_t *last = NULL;
-  for (window_t *win = windows; win; win = win->next) {
-    if (!win->visible) continue;
-    int t = titlebar_height(win);
-    int s = statusbar_height(win);
-    if (CONTAINS(x, y, win->frame.x, win->frame.y-t, win->frame.w, win->frame.h+t+s)) {
-      last = win;
-      if (!win->disabled) {
-        send_message(win, kWindowMessageHitTest, MAKEDWORD(x - win->frame.x, y - win->frame.y), &last);
-      }
-    }
+  window_t *last = hit_test_top_level(x, y);
+  if (last && !last->disabled) {
+    window_t *win = last;
+    send_message(win, kWindowMessageHitTest, MAKEDWORD(x - win->frame.x, y - win->frame.y), &last);
   }
   return last;
 }
@@ -235,12 +499,24 @@ void set_focus(window_t* win) {
   _focused = win;
 }
 
-// Invalidate window (request repaint)
+// Invalidate window (request repaint with a fresh display list)
 void invalidate_window(window_t *win) {
-  if (!win->parent) {
-    post_message(win, kWindowMessageNonClientPaint, 0, NULL);
+  mark_dirty(win);
+  repaint_window(win);
+}
+
+// Invalidate part of a window's client area (NULL for all of it). Only the
+// damaged region of the root window is repainted, without its non-client area.
+void invalidate_rect(window_t *win, rect_t const *r) {
+  window_t *root = get_root_window(win);
+  rect_t damage = r ? *r : (rect_t){ 0, 0, win->frame.w, win->frame.h };
+  if (win != root) {
+    damage.x += win->frame.x - root->scroll[0];
+    damage.y += win->frame.y - root->scroll[1];
   }
-  post_message(win, kWindowMessagePaint, 0, NULL);
+  mark_dirty(win);
+  region_union_rect(&root->top->damage, &damage);
+  post_message(root, kWindowMessagePaint, 0, NULL);
 }
 
 // Get titlebar Y position
@@ -248,25 +524,44 @@ int window_title_bar_y(window_t const *win) {
   return win->frame.y + 2 - titlebar_height(win);
 }
 
-// Get child window by ID
-window_t *get_window_item(window_t const *win, uint32_t id) {
+static window_t *find_window_item(window_t const *win, uint32_t id) {
   for (window_t *item = win->children; item; item = item->next) {
     if (item->id == id) {
       return item;
     }
-    window_t *child = get_window_item(item, id);
+    window_t *child = find_window_item(item, id);
     if (child) return child;
   }
   return NULL;
 }
 
+// Get child window by ID
+window_t *get_window_item(window_t const *win, uint32_t id) {
+  window_t *root = get_root_window((window_t *)win);
+  item_table_t *table = root->top->items;
+  if (table && table->capacity) {
+    window_t *item = table->slots[find_item_slot(table, id)].win;
+    if (item && item->id == id) {
+      // Below a nested window, the match must also be inside it
+      window_t *p = item->parent;
+      while (p != win && p != root) p = p->parent;
+      if (p == win) return item;
+    }
+  }
+  window_t *item = find_window_item(win, id);
+  if (item && win == root) {
+    index_window_item(item, id);
+  }
+  return item;
+}
+
 // Set window item text
 void set_window_item_text(window_t *win, uint32_t id, const char *fmt, ...) {
   window_t *item = get_window_item(win, id);
   if (!item) return;
   va_list args;
   va_start(args, fmt);
-  vsnprintf(item->title, sizeof(item->title), fmt, args);
+  vsnprintf(item->cold->title, sizeof(item->cold->title), fmt, args);
   va_end(args);
   invalidate_window(item);
 }
@@ -282,7 +577,9 @@ extern result_t win_space(window_t *win, uint32_t msg, uint32_t wparam, void *lp
 window_t *create_window2(windef_t const *def, rect_t const *r, window_t *parent) {
   rect_t rect = {r->x, r->y, def->w, def->h};
   window_t *win = create_window(def->text, def->flags, &rect, parent, def->proc, NULL);
+  unindex_window_item(win);
   win->id = def->id;
+  index_window_item(win, win->id);
   return win;
 }
 
@@ -311,7 +608,6 @@ void load_window_children(window_t *win, windef_t const *def) {
 
 // Show or hide window
 void show_window(window_t *win, bool visible) {
-  post_message(win, kWindowMessageRefreshStencil, 0, NULL);
   if (!visible) {
     invalidate_overlaps(win);
     if (_focused == win) set_focus(NULL);
@@ -322,17 +618,11 @@ void show_window(window_t *win, bool visible) {
     set_focus(win);
   }
   win->visible = visible;
+  invalidate_hit_test(win);
+  update_window_visibility(win, NULL);
   post_message(win, kWindowMessageShowWindow, visible, NULL);
 }
 
-// Check if pointer is a valid window
-bool is_window(window_t *win) {
-  for (window_t *w = windows; w; w = w->next) {
-    if (w == win) return true;
-  }
-  return false;
-}
-
 // Enable or disable window
 void enable_window(window_t *win, bool enable) {
   if (!enable && _focused == win) {